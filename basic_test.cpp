@@ -0,0 +1,169 @@
+#include "basic_thread_pool.h"
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// instantiation coverage for the compile-time configured pool: every
+// policy combination used here is a distinct template instantiation, so
+// this target catches config-dependent compile breaks as well as
+// behaviour.
+
+namespace {
+
+// the inner-loop shape: no stats, no priorities, no stealing, small sbo
+struct MinimalConfig {
+    static constexpr bool enable_stats = false;
+    static constexpr bool enable_priorities = false;
+    static constexpr bool enable_stealing = false;
+    static constexpr size_t task_sbo_size = 64;
+};
+
+// stats and stealing without priorities
+struct StatsConfig {
+    static constexpr bool enable_stats = true;
+    static constexpr bool enable_priorities = false;
+    static constexpr bool enable_stealing = true;
+    static constexpr size_t task_sbo_size = 128;
+};
+
+// sbo too small for a packaged_task, forcing the heap path
+struct TinySboConfig {
+    static constexpr bool enable_stats = false;
+    static constexpr bool enable_priorities = true;
+    static constexpr bool enable_stealing = true;
+    static constexpr size_t task_sbo_size = 16;
+};
+
+void test_default_config() {
+    std::cout << "test 1: default config ";
+
+    BasicThreadPool<> pool(4);
+
+    auto future = pool.submit([](int a, int b) { return a + b; }, 2, 3);
+    assert(future.get() == 5);
+
+    std::atomic<int> count{0};
+    for (int i = 0; i < 1000; ++i) {
+        pool.post([&count]() { count++; });
+    }
+    pool.wait_all();
+    assert(count == 1000);
+
+    auto stats = pool.get_stats();
+    assert(stats.tasks_completed == 1001);
+    assert(stats.total_tasks_submitted == 1001);
+
+    std::cout << "PASSED\n";
+}
+
+void test_minimal_config() {
+    std::cout << "test 2: minimal config ";
+
+    BasicThreadPool<MinimalConfig> pool(2);
+
+    std::atomic<int> count{0};
+    for (int i = 0; i < 1000; ++i) {
+        pool.post([&count]() { count++; });
+    }
+    pool.wait_all();
+    assert(count == 1000);
+
+    auto future = pool.submit([]() { return 42; });
+    assert(future.get() == 42);
+
+    std::cout << "PASSED\n";
+}
+
+void test_priorities() {
+    std::cout << "test 3: priorities ";
+
+    BasicThreadPool<TinySboConfig> pool(1);
+
+    // hold the single worker so the queue builds up
+    std::atomic<bool> gate{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&gate, &blocked]() {
+        blocked = true;
+        while (!gate) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked) {
+        std::this_thread::yield();
+    }
+
+    std::vector<int> order;
+    std::mutex order_mutex;
+    for (int i = 0; i < 4; ++i) {
+        pool.post(BasicPriority::NORMAL, [&order, &order_mutex]() {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(1);
+        });
+    }
+    for (int i = 0; i < 4; ++i) {
+        pool.post(BasicPriority::HIGH, [&order, &order_mutex]() {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(0);
+        });
+    }
+
+    gate = true;
+    pool.wait_all();
+
+    assert(order.size() == 8);
+    for (size_t i = 0; i < 4; ++i) {
+        assert(order[i] == 0);
+    }
+    for (size_t i = 4; i < 8; ++i) {
+        assert(order[i] == 1);
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void test_stealing_stats() {
+    std::cout << "test 4: stealing stats ";
+
+    BasicThreadPool<StatsConfig> pool(4);
+
+    std::atomic<int> count{0};
+    for (int i = 0; i < 2000; ++i) {
+        pool.post([&count]() {
+            volatile int spin = 0;
+            for (int j = 0; j < 50; ++j) {
+                spin = spin + j;
+            }
+            count++;
+        });
+    }
+    pool.wait_all();
+    assert(count == 2000);
+
+    auto stats = pool.get_stats();
+    assert(stats.tasks_completed == 2000);
+    assert(stats.tasks_stolen <= stats.tasks_completed);
+
+    std::cout << "PASSED\n";
+}
+
+}
+
+int main() {
+    std::cout << "BasicThreadPool test suite\n";
+
+    try {
+        test_default_config();
+        test_minimal_config();
+        test_priorities();
+        test_stealing_stats();
+
+        std::cout << "ALL TESTS PASSED\n";
+
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nFAILED: " << e.what() << "\n";
+        return 1;
+    }
+}
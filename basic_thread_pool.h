@@ -0,0 +1,400 @@
+#ifndef BASIC_THREAD_POOL_H
+#define BASIC_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// header-only pool variant with compile-time configuration. the full
+// ThreadPool compiles every feature into the hot path unconditionally;
+// call-sites that only need "push a tiny kernel, pop it, run it" can
+// instantiate this template with the features they use and let the
+// compiler delete the rest. everything here is deliberately lock-based
+// and small: the payoff is specialization and inlining, not a second
+// work-stealing runtime.
+//
+//     struct InnerLoopConfig {
+//         static constexpr bool enable_stats = false;
+//         static constexpr bool enable_priorities = false;
+//         static constexpr bool enable_stealing = false;
+//         static constexpr size_t task_sbo_size = 64;
+//     };
+//     BasicThreadPool<InnerLoopConfig> pool(4);
+
+// default configuration mirrors the full pool's behaviour
+struct DefaultPoolConfig {
+    // per-worker sharded counters behind get_stats()
+    static constexpr bool enable_stats = true;
+    // submit(BasicPriority::HIGH, ...) jumps the queue; off makes every
+    // submit a plain push_back and removes the branch
+    static constexpr bool enable_priorities = true;
+    // idle workers scan sibling queues before sleeping
+    static constexpr bool enable_stealing = true;
+    // inline storage per task; captures larger than this take one heap
+    // allocation, exactly like the full pool's Task
+    static constexpr size_t task_sbo_size = 128;
+};
+
+enum class BasicPriority {
+    HIGH = 0,
+    NORMAL = 1
+};
+
+template<class Config = DefaultPoolConfig>
+class BasicThreadPool {
+private:
+    // move-only type-erased callable with Config-sized inline storage;
+    // same Ops-table shape as the full pool's Task, minus the arena
+    class BasicTask {
+    private:
+        struct Ops {
+            void (*invoke)(void*);
+            void (*relocate)(void*, void*);
+            void (*destroy)(void*);
+        };
+
+        template<class F>
+        struct InlineOps {
+            static void invoke(void* storage) {
+                (*static_cast<F*>(storage))();
+            }
+            static void relocate(void* from, void* to) {
+                new (to) F(std::move(*static_cast<F*>(from)));
+                static_cast<F*>(from)->~F();
+            }
+            static void destroy(void* storage) {
+                static_cast<F*>(storage)->~F();
+            }
+            static constexpr Ops ops = {&invoke, &relocate, &destroy};
+        };
+
+        template<class F>
+        struct HeapOps {
+            static F* get(void* storage) {
+                return *static_cast<F**>(storage);
+            }
+            static void invoke(void* storage) {
+                (*get(storage))();
+            }
+            static void relocate(void* from, void* to) {
+                *static_cast<F**>(to) = get(from);
+            }
+            static void destroy(void* storage) {
+                delete get(storage);
+            }
+            static constexpr Ops ops = {&invoke, &relocate, &destroy};
+        };
+
+        alignas(std::max_align_t) unsigned char storage_[Config::task_sbo_size];
+        const Ops* ops_;
+
+    public:
+        BasicTask() : ops_(nullptr) {}
+
+        template<class F,
+                 class D = typename std::decay<F>::type,
+                 class = typename std::enable_if<!std::is_same<D, BasicTask>::value>::type>
+        BasicTask(F&& f) {
+            if constexpr (sizeof(D) <= Config::task_sbo_size &&
+                          alignof(D) <= alignof(std::max_align_t)) {
+                new (storage_) D(std::forward<F>(f));
+                ops_ = &InlineOps<D>::ops;
+            } else {
+                *reinterpret_cast<D**>(storage_) = new D(std::forward<F>(f));
+                ops_ = &HeapOps<D>::ops;
+            }
+        }
+
+        BasicTask(BasicTask&& other) noexcept : ops_(other.ops_) {
+            if (ops_) {
+                ops_->relocate(other.storage_, storage_);
+                other.ops_ = nullptr;
+            }
+        }
+
+        BasicTask& operator=(BasicTask&& other) noexcept {
+            if (this != &other) {
+                if (ops_) {
+                    ops_->destroy(storage_);
+                }
+                ops_ = other.ops_;
+                if (ops_) {
+                    ops_->relocate(other.storage_, storage_);
+                    other.ops_ = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        BasicTask(const BasicTask&) = delete;
+        BasicTask& operator=(const BasicTask&) = delete;
+
+        ~BasicTask() {
+            if (ops_) {
+                ops_->destroy(storage_);
+            }
+        }
+
+        void operator()() {
+            ops_->invoke(storage_);
+        }
+    };
+
+    struct Counters {
+        std::atomic<size_t> submitted{0};
+        std::atomic<size_t> completed{0};
+        std::atomic<size_t> stolen{0};
+    };
+    struct NoCounters {};
+
+    // one padded block per worker; the counters member vanishes when
+    // stats are compiled out
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<BasicTask> queue;
+        typename std::conditional<Config::enable_stats, Counters, NoCounters>::type counters;
+    };
+
+public:
+    struct Stats {
+        size_t total_tasks_submitted;
+        size_t tasks_completed;
+        size_t tasks_stolen;
+    };
+
+    explicit BasicThreadPool(size_t num_threads)
+        : stop_(false)
+        , pending_(0)
+        , next_queue_(0) {
+        if (num_threads == 0) {
+            throw std::invalid_argument("Thread pool must have at least one thread");
+        }
+        worker_data_.reset(new Worker[num_threads]);
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers_.emplace_back([this, i] { worker_thread(i); });
+        }
+    }
+
+    ~BasicThreadPool() {
+        shutdown();
+    }
+
+    BasicThreadPool(const BasicThreadPool&) = delete;
+    BasicThreadPool& operator=(const BasicThreadPool&) = delete;
+
+    template<class F, class... Args>
+    auto submit(F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type> {
+        return submit(BasicPriority::NORMAL,
+                      std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template<class F, class... Args>
+    auto submit(BasicPriority priority, F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type> {
+        using return_type = typename std::invoke_result<F, Args...>::type;
+
+        if (stop_) {
+            throw std::runtime_error("Cannot submit task to stopped thread pools");
+        }
+
+        std::packaged_task<return_type()> task(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+        std::future<return_type> result = task.get_future();
+        enqueue(priority, BasicTask(std::move(task)));
+        return result;
+    }
+
+    // fire-and-forget: no packaged_task, no future. with stats and
+    // priorities compiled out this is a mutex, a push_back and a notify,
+    // and the callable's body is a candidate for inlining into the
+    // worker loop's invoke
+    template<class F>
+    void post(F&& f) {
+        if (stop_) {
+            throw std::runtime_error("Cannot submit task to stopped thread pools");
+        }
+        enqueue(BasicPriority::NORMAL, BasicTask(std::forward<F>(f)));
+    }
+
+    template<class F>
+    void post(BasicPriority priority, F&& f) {
+        if (stop_) {
+            throw std::runtime_error("Cannot submit task to stopped thread pools");
+        }
+        enqueue(priority, BasicTask(std::forward<F>(f)));
+    }
+
+    void wait_all() {
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        idle_cv_.wait(lock, [this] {
+            return pending_.load(std::memory_order_seq_cst) == 0;
+        });
+    }
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            if (stop_.exchange(true)) {
+                return;
+            }
+        }
+        sleep_cv_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    size_t num_threads() const {
+        return workers_.size();
+    }
+
+    // only instantiable when stats are compiled in; a no-stats config
+    // that calls this fails at compile time instead of lying with zeros
+    Stats get_stats() const {
+        static_assert(Config::enable_stats,
+                      "get_stats() requires Config::enable_stats");
+        Stats stats{0, 0, 0};
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            stats.total_tasks_submitted +=
+                worker_data_[i].counters.submitted.load(std::memory_order_seq_cst);
+            stats.tasks_completed +=
+                worker_data_[i].counters.completed.load(std::memory_order_seq_cst);
+            stats.tasks_stolen +=
+                worker_data_[i].counters.stolen.load(std::memory_order_seq_cst);
+        }
+        return stats;
+    }
+
+private:
+    void enqueue(BasicPriority priority, BasicTask task) {
+        size_t target = next_queue_++ % workers_.size();
+        Worker& worker = worker_data_[target];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if constexpr (Config::enable_priorities) {
+                if (priority == BasicPriority::HIGH) {
+                    worker.queue.push_front(std::move(task));
+                } else {
+                    worker.queue.push_back(std::move(task));
+                }
+            } else {
+                (void)priority;
+                worker.queue.push_back(std::move(task));
+            }
+        }
+        if constexpr (Config::enable_stats) {
+            worker.counters.submitted.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+        // the lock orders this push against a worker evaluating its wait
+        // predicate, closing the lost-wakeup window
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        if constexpr (Config::enable_stealing) {
+            // any worker can serve the task
+            sleep_cv_.notify_one();
+        } else {
+            // only the round-robin target can; wake everyone and let the
+            // others re-check their own queue
+            sleep_cv_.notify_all();
+        }
+    }
+
+    bool take(size_t thread_id, BasicTask& task) {
+        Worker& own = worker_data_[thread_id];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.queue.empty()) {
+                task = std::move(own.queue.front());
+                own.queue.pop_front();
+                return true;
+            }
+        }
+        if constexpr (Config::enable_stealing) {
+            for (size_t i = 1; i < workers_.size(); ++i) {
+                Worker& victim = worker_data_[(thread_id + i) % workers_.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.queue.empty()) {
+                    // steal from the back, opposite end to the owner
+                    task = std::move(victim.queue.back());
+                    victim.queue.pop_back();
+                    if constexpr (Config::enable_stats) {
+                        own.counters.stolen.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void worker_thread(size_t thread_id) {
+        while (true) {
+            BasicTask task;
+            if (take(thread_id, task)) {
+                task();
+                if constexpr (Config::enable_stats) {
+                    worker_data_[thread_id].counters.completed.fetch_add(
+                        1, std::memory_order_relaxed);
+                }
+                if (pending_.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+                    std::lock_guard<std::mutex> lock(sleep_mutex_);
+                    idle_cv_.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            if (stop_.load(std::memory_order_relaxed)) {
+                // drain before exiting so queued work is not stranded;
+                // without stealing the backlog may sit in a sibling's
+                // queue, so yield rather than spin on it
+                if (pending_.load(std::memory_order_seq_cst) == 0) {
+                    break;
+                }
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+            sleep_cv_.wait(lock, [this, thread_id] {
+                if (stop_.load(std::memory_order_relaxed)) {
+                    return true;
+                }
+                if constexpr (Config::enable_stealing) {
+                    return pending_.load(std::memory_order_seq_cst) != 0;
+                } else {
+                    // pending counts work in queues we cannot steal
+                    // from; only our own queue matters here
+                    std::lock_guard<std::mutex> own(worker_data_[thread_id].mutex);
+                    return !worker_data_[thread_id].queue.empty();
+                }
+            });
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<Worker[]> worker_data_;
+
+    std::atomic<bool> stop_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> next_queue_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    std::condition_variable idle_cv_;
+};
+
+#endif  // BASIC_THREAD_POOL_H
@@ -0,0 +1,177 @@
+#include "thread_pool.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <random>
+
+// benchmark harness: warmup + repeated runs per scenario, median/p99/
+// stddev reported, CSV on stdout so scaling curves can be charted per
+// commit. human-readable progress goes to stderr.
+
+namespace {
+
+struct Scenario {
+    std::string name;
+    size_t tasks;
+    void (*run)(ThreadPool&, size_t);
+};
+
+double run_timed(ThreadPool& pool, const Scenario& scenario) {
+    auto start = std::chrono::steady_clock::now();
+    scenario.run(pool, scenario.tasks);
+    pool.wait_all();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void scenario_empty(ThreadPool& pool, size_t tasks) {
+    for (size_t i = 0; i < tasks; ++i) {
+        pool.post([]() {
+            volatile int x = 0;
+            x = x + 1;
+        });
+    }
+}
+
+void scenario_mixed(ThreadPool& pool, size_t tasks) {
+    for (size_t i = 0; i < tasks; ++i) {
+        size_t spin = (i % 100) * 20;
+        pool.post([spin]() {
+            volatile size_t acc = 0;
+            for (size_t j = 0; j < spin; ++j) {
+                acc = acc + j;
+            }
+        });
+    }
+}
+
+void scenario_steal_heavy(ThreadPool& pool, size_t tasks) {
+    // skewed burst: a few very expensive tasks in a sea of cheap ones,
+    // forcing thieves to rebalance
+    for (size_t i = 0; i < tasks; ++i) {
+        size_t spin = (i % 97 == 0) ? 50000 : 50;
+        pool.post([spin]() {
+            volatile size_t acc = 0;
+            for (size_t j = 0; j < spin; ++j) {
+                acc = acc + j;
+            }
+        });
+    }
+}
+
+void scenario_priority_heavy(ThreadPool& pool, size_t tasks) {
+    for (size_t i = 0; i < tasks; ++i) {
+        Priority priority = static_cast<Priority>(i % 3);
+        pool.post(priority, []() {
+            volatile int x = 0;
+            x = x + 1;
+        });
+    }
+}
+
+struct Stats {
+    double median;
+    double p99;
+    double stddev;
+};
+
+Stats summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+
+    Stats stats;
+    stats.median = samples[samples.size() / 2];
+
+    size_t p99_index = static_cast<size_t>(std::ceil(samples.size() * 0.99)) - 1;
+    stats.p99 = samples[std::min(p99_index, samples.size() - 1)];
+
+    double mean = 0;
+    for (double s : samples) {
+        mean += s;
+    }
+    mean /= samples.size();
+
+    double variance = 0;
+    for (double s : samples) {
+        variance += (s - mean) * (s - mean);
+    }
+    stats.stddev = std::sqrt(variance / samples.size());
+
+    return stats;
+}
+
+}
+
+int main(int argc, char** argv) {
+    // scale=1 keeps a full sweep under a few minutes on a laptop; crank
+    // it up for stable numbers on big machines
+    size_t scale = 1;
+    size_t reps = 7;
+    size_t warmup = 2;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) {
+            scale = std::stoul(argv[++i]);
+        } else if (arg == "--reps" && i + 1 < argc) {
+            reps = std::stoul(argv[++i]);
+        } else {
+            std::cerr << "usage: bench [--scale N] [--reps N]\n";
+            return 1;
+        }
+    }
+
+    std::vector<Scenario> scenarios = {
+        {"empty_tasks", 100000 * scale, &scenario_empty},
+        {"mixed_duration", 20000 * scale, &scenario_mixed},
+        {"steal_heavy", 20000 * scale, &scenario_steal_heavy},
+        {"priority_heavy", 50000 * scale, &scenario_priority_heavy},
+    };
+
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw == 0) {
+        hw = 1;
+    }
+    std::vector<size_t> thread_counts = {1, 2, 4};
+    thread_counts.push_back(hw);
+    std::sort(thread_counts.begin(), thread_counts.end());
+    thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()),
+                        thread_counts.end());
+
+    std::cout << "scenario,threads,tasks,reps,median_ms,p99_ms,stddev_ms,tasks_per_sec\n";
+
+    for (const Scenario& scenario : scenarios) {
+        for (size_t threads : thread_counts) {
+            std::cerr << scenario.name << " @ " << threads << " threads... ";
+
+            ThreadPool pool(threads);
+
+            for (size_t i = 0; i < warmup; ++i) {
+                run_timed(pool, scenario);
+            }
+
+            std::vector<double> samples;
+            samples.reserve(reps);
+            for (size_t i = 0; i < reps; ++i) {
+                samples.push_back(run_timed(pool, scenario));
+            }
+
+            Stats stats = summarize(std::move(samples));
+            double throughput = scenario.tasks / (stats.median / 1000.0);
+
+            std::cerr << stats.median << " ms median\n";
+            std::cout << scenario.name << ","
+                      << threads << ","
+                      << scenario.tasks << ","
+                      << reps << ","
+                      << stats.median << ","
+                      << stats.p99 << ","
+                      << stats.stddev << ","
+                      << static_cast<size_t>(throughput) << "\n";
+        }
+    }
+
+    return 0;
+}
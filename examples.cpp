@@ -87,27 +87,19 @@ void example_parallel_computation() {
     ThreadPool pool(num_threads);
     
     auto parallel_time = measure_time([&]() {
-        std::vector<std::future<long long>> futures;
-        size_t chunk_size = N / num_threads;
-        
-        for (size_t i = 0; i < num_threads; ++i) {
-            size_t start = i * chunk_size;
-            size_t end = (i == num_threads - 1) ? N : (i + 1) * chunk_size;
-            
-            futures.push_back(pool.submit([start, end]() {
-                long long sum = 0;
+        // parallel_reduce splits the range dynamically, so uneven
+        // iteration costs get rebalanced by work stealing instead of
+        // being baked into static chunks
+        long long total = pool.parallel_reduce(
+            size_t(0), N, 0LL,
+            [](size_t start, size_t end, long long sum) {
                 for (size_t j = start; j < end; ++j) {
-                    sum += j * j;
+                    sum += static_cast<long long>(j) * j;
                 }
                 return sum;
-            }));
-        }
-        
-        long long total = 0;
-        for (auto& future : futures) {
-            total += future.get();
-        }
-        
+            },
+            [](long long a, long long b) { return a + b; });
+
         std::cout << "parallel sum of squares: " << total << "\n";
     });
     
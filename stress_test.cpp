@@ -0,0 +1,259 @@
+#include "thread_pool.h"
+#include <iostream>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+// stress and scalability suite. the regular suite proves features work
+// at 2-4 threads and a few hundred tasks; this one hammers the races
+// those sizes never reach -- concurrent submit/steal/shutdown, counter
+// drift at high concurrency, recursion from inside tasks -- and guards
+// against throughput collapse. build with `make stress`, or
+// `make stress-tsan` for the thread-sanitized binary that must come
+// back clean before any lock-free change lands.
+
+namespace {
+
+// spin long enough to be real work without dominating the run
+void burn(int iters) {
+    volatile int sink = 0;
+    for (int i = 0; i < iters; ++i) {
+        sink = sink + i;
+    }
+}
+
+void stress_concurrent_submit() {
+    std::cout << "stress 1: concurrent submit torture ";
+
+    // many external producers racing each other and the stealing
+    // workers; every entry point gets traffic so the counter shards and
+    // the deque protocols are exercised together
+    ThreadPool pool(4);
+
+    constexpr int producers = 8;
+    constexpr int per_producer = 2000;
+    std::atomic<size_t> count{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&pool, &count, p]() {
+            for (int i = 0; i < per_producer; ++i) {
+                switch (i % 4) {
+                case 0:
+                    pool.post([&count]() { burn(20); count++; });
+                    break;
+                case 1:
+                    pool.post(Priority::HIGH, [&count]() { count++; });
+                    break;
+                case 2:
+                    pool.post(Priority::LOW, [&count]() { count++; });
+                    break;
+                default:
+                    pool.submit_with_key(static_cast<uint64_t>(p), [&count]() {
+                        burn(20);
+                        count++;
+                    });
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    pool.wait_all();
+
+    assert(count == producers * per_producer);
+    auto stats = pool.get_stats();
+    assert(stats.total_tasks_submitted == producers * per_producer);
+    assert(stats.tasks_completed == producers * per_producer);
+
+    std::cout << "PASSED (" << stats.tasks_stolen << " stolen)\n";
+}
+
+void stress_shutdown_races_submit() {
+    std::cout << "stress 2: shutdown racing submit ";
+
+    // producers keep submitting while another thread tears the pool
+    // down. submissions that beat the stop flag run under the graceful
+    // drain; submissions that lose must throw, never crash or wedge.
+    for (int round = 0; round < 5; ++round) {
+        ThreadPool pool(4);
+        std::atomic<size_t> accepted{0};
+        std::atomic<size_t> ran{0};
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < 4; ++p) {
+            threads.emplace_back([&pool, &accepted, &ran]() {
+                try {
+                    for (;;) {
+                        pool.post([&ran]() { burn(10); ran++; });
+                        accepted++;
+                    }
+                } catch (const std::runtime_error&) {
+                    // the pool stopped under us, which is the point
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pool.shutdown_graceful();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // every task that ran came from a post() that returned, so ran
+        // never exceeds accepted; a post racing the very end of the
+        // drain may strand its task, so exact equality is not promised
+        assert(ran <= accepted);
+        assert(ran > 0);
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void stress_recursive_submit() {
+    std::cout << "stress 3: submit-from-task recursion ";
+
+    // a chain ten thousand deep where every link is submitted from
+    // inside its predecessor; the worker-local fast path must neither
+    // overflow anything nor lose the tail under stealing
+    ThreadPool pool(4);
+
+    constexpr int depth = 10000;
+    std::atomic<int> reached{0};
+    std::promise<void> done;
+
+    std::function<void(int)> step = [&](int remaining) {
+        reached++;
+        if (remaining == 0) {
+            done.set_value();
+            return;
+        }
+        pool.post([&step, remaining]() { step(remaining - 1); });
+    };
+    pool.post([&step]() { step(depth); });
+
+    done.get_future().wait();
+    pool.wait_all();
+    assert(reached == depth + 1);
+
+    std::cout << "PASSED\n";
+}
+
+void stress_scaling() {
+    std::cout << "stress 4: scaling ";
+
+    // throughput with N workers against N/2 on identical cpu-bound
+    // work. on a many-core box the ratio should approach 2; the
+    // assertion only rejects outright collapse (ratio far below 1 means
+    // added workers made things slower), because CI may pin us to one
+    // core where no speedup exists to measure.
+    size_t n = std::max<size_t>(4, std::thread::hardware_concurrency());
+
+    auto run = [](size_t workers) {
+        ThreadPool pool(workers);
+        constexpr int tasks = 4000;
+        std::atomic<int> count{0};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < tasks; ++i) {
+            pool.post([&count]() { burn(4000); count++; });
+        }
+        pool.wait_all();
+        auto elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        assert(count == tasks);
+        return tasks / elapsed;
+    };
+
+    double half = run(n / 2);
+    double full = run(n);
+    double ratio = full / half;
+
+    assert(ratio > 0.5);
+
+    std::cout << "PASSED (" << n / 2 << "->" << n
+              << " workers, ratio " << ratio << ")\n";
+}
+
+void stress_soak() {
+    std::cout << "stress 5: randomized soak ";
+
+    // several seconds of mixed traffic: random priorities, random task
+    // sizes from trivial to chunky, keyed and deadline entries woven
+    // through. the books must balance exactly at the end -- everything
+    // submitted was completed, shed, or dropped.
+    ThreadPool pool(4);
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<int> size(1, 2000);
+    std::uniform_int_distribution<uint64_t> key(0, 15);
+
+    constexpr int tasks = 30000;
+    std::atomic<size_t> count{0};
+
+    for (int i = 0; i < tasks; ++i) {
+        int iters = size(rng);
+        auto work = [&count, iters]() {
+            burn(iters);
+            count++;
+        };
+        switch (kind(rng)) {
+        case 0:
+            pool.post(Priority::HIGH, work);
+            break;
+        case 1:
+        case 2:
+            pool.post(Priority::LOW, work);
+            break;
+        case 3:
+            pool.submit_with_key(key(rng), work);
+            break;
+        case 4:
+            // generous deadline: sheds only if the soak bogs down, and
+            // a shed still balances the books below
+            pool.submit_with_deadline(
+                std::chrono::steady_clock::now() + std::chrono::seconds(60), work);
+            break;
+        default:
+            pool.post(work);
+            break;
+        }
+    }
+    pool.wait_all();
+
+    auto stats = pool.get_stats();
+    assert(stats.total_tasks_submitted == tasks);
+    // completed counts only tasks that ran; sheds and drops are
+    // disposals and the three together must cover every submission
+    assert(stats.tasks_completed == count);
+    assert(stats.tasks_completed + stats.tasks_shed + stats.tasks_dropped == tasks);
+
+    std::cout << "PASSED (" << count << " ran, "
+              << stats.tasks_shed << " shed)\n";
+}
+
+}
+
+int main() {
+    std::cout << "Stress suite\n";
+
+    try {
+        stress_concurrent_submit();
+        stress_shutdown_races_submit();
+        stress_recursive_submit();
+        stress_scaling();
+        stress_soak();
+
+        std::cout << "ALL STRESS TESTS PASSED\n";
+
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\nFAILED: " << e.what() << "\n";
+        return 1;
+    }
+}
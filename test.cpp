@@ -146,9 +146,928 @@ void test_shutdown_immediate() {
     std::cout << "PASSED (completed " << completed << " tasks before shutdown)\n";
 }
 
+void test_submit_bulk() {
+    std::cout << "test 9: bulk submission ";
+    ThreadPool pool(4);
+
+    std::vector<std::function<int()>> tasks;
+    for (int i = 0; i < 200; ++i) {
+        tasks.push_back([i]() { return i * 2; });
+    }
+
+    auto futures = pool.submit_bulk(tasks.begin(), tasks.end());
+    assert(futures.size() == 200);
+
+    for (int i = 0; i < 200; ++i) {
+        assert(futures[i].get() == i * 2);
+    }
+
+    auto high = pool.submit_bulk(Priority::HIGH, tasks.begin(), tasks.begin() + 10);
+    for (int i = 0; i < 10; ++i) {
+        assert(high[i].get() == i * 2);
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void test_parallel_for_reduce() {
+    std::cout << "test 10: parallel_for/reduce ";
+    ThreadPool pool(4);
+
+    const size_t N = 10000;
+    std::vector<int> values(N, 0);
+
+    pool.parallel_for(size_t(0), N, [&values](size_t i) {
+        values[i] = static_cast<int>(i);
+    });
+
+    for (size_t i = 0; i < N; ++i) {
+        assert(values[i] == static_cast<int>(i));
+    }
+
+    long long sum = pool.parallel_reduce(
+        size_t(0), N, 0LL,
+        [](size_t b, size_t e, long long acc) {
+            for (size_t i = b; i < e; ++i) {
+                acc += static_cast<long long>(i);
+            }
+            return acc;
+        },
+        [](long long a, long long b) { return a + b; });
+
+    assert(sum == static_cast<long long>(N) * (N - 1) / 2);
+
+    std::cout << "PASSED\n";
+}
+
+void test_post() {
+    std::cout << "test 11: post ";
+    ThreadPool pool(4);
+
+    std::atomic<int> counter{0};
+    for (int i = 0; i < 100; ++i) {
+        pool.post([&counter]() { counter++; });
+    }
+    pool.wait_all();
+    assert(counter == 100);
+
+    std::atomic<int> errors{0};
+    pool.set_exception_handler([&errors](std::exception_ptr) { errors++; });
+    pool.post([]() { throw std::runtime_error("posted failure"); });
+    pool.post(Priority::HIGH, [&counter]() { counter++; });
+    pool.wait_all();
+    assert(errors == 1);
+    assert(counter == 101);
+
+    std::cout << "PASSED\n";
+}
+
+void test_affinity_options() {
+    std::cout << "test 12: affinity options ";
+
+    ThreadPool::Options options;
+    options.pin_threads = true;
+    options.numa_nodes = 2;
+    ThreadPool pool(4, options);
+
+    assert(pool.num_nodes() == 2);
+
+    auto near0 = pool.submit_to_node(0, []() { return 1; });
+    auto near1 = pool.submit_to_node(1, []() { return 2; });
+    assert(near0.get() == 1);
+    assert(near1.get() == 2);
+
+    bool rejected = false;
+    try {
+        pool.submit_to_node(7, []() {});
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    std::cout << "PASSED\n";
+}
+
+void test_continuations() {
+    std::cout << "test 13: continuations ";
+
+    // one worker on purpose: a blocking join inside then() would deadlock
+    ThreadPool pool(1);
+
+    auto chained = pool.async([]() { return 21; })
+                       .then([](int x) { return x * 2; })
+                       .then([](int x) { return x + 1; });
+    assert(chained.get() == 43);
+
+    // attaching after the antecedent already finished must still run
+    auto done = pool.async([]() { return 5; });
+    pool.wait_all();
+    auto late = done.then([](int x) { return x * x; });
+    assert(late.get() == 25);
+
+    // void chaining
+    std::atomic<int> ran{0};
+    auto tail = pool.async([&ran]() { ran++; }).then([&ran]() { ran++; });
+    tail.get();
+    assert(ran == 2);
+
+    std::cout << "PASSED\n";
+}
+
+void test_elastic_sizing() {
+    std::cout << "test 14: elastic sizing ";
+
+    ThreadPool::Options options;
+    options.min_threads = 1;
+    options.max_threads = 4;
+    ThreadPool pool(1, options);
+
+    assert(pool.num_threads() == 4);
+    assert(pool.active_threads() == 1);
+
+    // sustained backlog should ramp the active set up
+    std::atomic<int> counter{0};
+    for (int i = 0; i < 2000; ++i) {
+        pool.post([&counter]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            counter++;
+        });
+    }
+    pool.wait_all();
+    assert(counter == 2000);
+
+    size_t peak = pool.active_threads();
+    assert(peak >= 2 && peak <= 4);
+
+    // a long idle spell should retire workers back toward the minimum
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    assert(pool.active_threads() < peak);
+
+    // and retired workers must re-attach when load returns
+    counter = 0;
+    for (int i = 0; i < 200; ++i) {
+        pool.post([&counter]() { counter++; });
+    }
+    pool.wait_all();
+    assert(counter == 200);
+
+    std::cout << "PASSED (peak " << peak << " workers)\n";
+}
+
+void test_worker_local_submit() {
+    std::cout << "test 15: worker-local submit ";
+    ThreadPool pool(2);
+
+    // recursive spawn from inside workers; children land on the
+    // spawning worker's own deque instead of round-robin
+    std::atomic<int> count{0};
+    std::function<void(int)> spawn = [&](int depth) {
+        count++;
+        if (depth > 0) {
+            pool.post([&spawn, depth]() { spawn(depth - 1); });
+            pool.post([&spawn, depth]() { spawn(depth - 1); });
+        }
+    };
+
+    pool.post([&spawn]() { spawn(10); });
+    pool.wait_all();
+    assert(count == (1 << 11) - 1);
+
+    std::cout << "PASSED\n";
+}
+
+void test_task_group() {
+    std::cout << "test 16: task group ";
+    ThreadPool pool(4);
+
+    std::atomic<int> slow{0};
+    std::atomic<int> fast{0};
+
+    // two independent groups; waiting on one must not wait on the other
+    TaskGroup background(pool);
+    for (int i = 0; i < 2; ++i) {
+        background.run([&slow]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            slow++;
+        });
+    }
+
+    TaskGroup group(pool);
+    for (int i = 0; i < 20; ++i) {
+        group.run([&fast]() { fast++; });
+    }
+    group.wait();
+    assert(fast == 20);
+
+    // the first exception from a group task resurfaces in wait()
+    TaskGroup failing(pool);
+    failing.run([]() { throw std::runtime_error("group failure"); });
+    bool caught = false;
+    try {
+        failing.wait();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+
+    background.wait();
+    assert(slow == 2);
+
+    std::cout << "PASSED\n";
+}
+
+#ifdef THREAD_POOL_HAS_COROUTINES
+CoTask<int> coro_compute(ThreadPool& pool) {
+    co_await pool.schedule();
+    co_return 21;
+}
+
+CoTask<int> coro_chain(ThreadPool& pool) {
+    int x = co_await coro_compute(pool);
+    co_await pool.schedule(Priority::HIGH);
+    co_return x * 2;
+}
+
+CoTask<void> coro_increment(ThreadPool& pool, std::atomic<int>& counter) {
+    co_await pool.schedule();
+    counter++;
+}
+#endif
+
+void test_coroutines() {
+    std::cout << "test 17: coroutines ";
+#ifdef THREAD_POOL_HAS_COROUTINES
+    ThreadPool pool(2);
+
+    auto chained = coro_chain(pool);
+    assert(chained.get() == 42);
+
+    std::atomic<int> counter{0};
+    auto incr = coro_increment(pool, counter);
+    incr.get();
+    assert(counter == 1);
+
+    std::cout << "PASSED\n";
+#else
+    std::cout << "SKIPPED (no coroutine support)\n";
+#endif
+}
+
+void test_steal_batching() {
+    std::cout << "test 18: steal batching ";
+    ThreadPool pool(4);
+
+    // pile a burst onto one worker's deque via a worker-local spawn so
+    // the other three have to raid it
+    std::atomic<int> count{0};
+    pool.post([&pool, &count]() {
+        for (int i = 0; i < 500; ++i) {
+            pool.post([&count]() {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                count++;
+            });
+        }
+    });
+    pool.wait_all();
+    assert(count == 500);
+
+    auto stats = pool.get_stats();
+    assert(stats.tasks_stolen >= stats.steal_batches);
+    assert(stats.tasks_stolen > 0);
+
+    std::cout << "PASSED (" << stats.tasks_stolen << " stolen in "
+              << stats.steal_batches << " batches)\n";
+}
+
+void test_timers() {
+    std::cout << "test 19: timers ";
+    ThreadPool pool(2);
+
+    std::atomic<int> fired{0};
+    std::atomic<long long> delay_us{0};
+    auto start = std::chrono::steady_clock::now();
+
+    pool.submit_after(std::chrono::milliseconds(30), [&fired, &delay_us, start]() {
+        delay_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        fired++;
+    });
+    pool.submit_at(std::chrono::steady_clock::now() + std::chrono::milliseconds(10),
+                   [&fired]() { fired++; });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    assert(fired == 2);
+    assert(delay_us >= 30000);  // a timer never fires early
+
+    std::atomic<int> ticks{0};
+    pool.submit_periodic(std::chrono::milliseconds(10), [&ticks]() { ticks++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    assert(ticks >= 3);
+
+    // shutdown just drops the unfired periodic re-arm
+    pool.shutdown_graceful();
+
+    std::cout << "PASSED\n";
+}
+
+void test_arena_churn() {
+    std::cout << "test 20: arena churn ";
+    ThreadPool pool(4);
+
+    // repeated waves so nodes freed by stealing workers flow through
+    // the remote-free lists and get recycled by the submitting thread
+    for (int wave = 0; wave < 20; ++wave) {
+        std::atomic<int> count{0};
+        for (int i = 0; i < 500; ++i) {
+            pool.post([&count]() { count++; });
+        }
+        pool.wait_all();
+        assert(count == 500);
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void test_pipeline() {
+    std::cout << "test 21: pipeline ";
+    ThreadPool pool(4);
+
+    Pipeline<int> pipeline(pool, 8);
+    pipeline.add_stage(4, [](int& x) { x = x * 2; });
+    pipeline.add_stage(2, [](int& x) { x = x + 1; });
+
+    std::vector<int> out;
+    pipeline.add_serial_stage([&out](int& x) { out.push_back(x); });
+
+    // 100 items through an 8-slot pipeline exercises the backpressure
+    for (int i = 0; i < 100; ++i) {
+        pipeline.push(i);
+    }
+    pipeline.wait();
+
+    assert(out.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        assert(out[i] == i * 2 + 1);  // serial stage saw feed order
+    }
+
+    // a throwing stage drops the item from later stage bodies but must
+    // not wedge the serial ordering behind it
+    std::atomic<int> errors{0};
+    pool.set_exception_handler([&errors](std::exception_ptr) { errors++; });
+
+    Pipeline<int> strict(pool, 4);
+    strict.add_stage(2, [](int& x) {
+        if (x < 0) {
+            throw std::runtime_error("bad item");
+        }
+    });
+    std::vector<int> survived;
+    strict.add_serial_stage([&survived](int& x) { survived.push_back(x); });
+    for (int i = 0; i < 10; ++i) {
+        strict.push(i == 5 ? -1 : i);
+    }
+    strict.wait();
+    assert(errors == 1);
+    assert(survived.size() == 9);
+
+    std::cout << "PASSED\n";
+}
+
+void test_instrumentation() {
+    std::cout << "test 22: instrumentation ";
+
+    ThreadPool::Options options;
+    options.enable_instrumentation = true;
+    ThreadPool pool(4, options);
+
+    const int n = 500;
+    for (int i = 0; i < n; ++i) {
+        pool.post([]() {
+            volatile int x = 0;
+            x = x + 1;
+        });
+    }
+    pool.wait_all();
+
+    auto detailed = pool.get_detailed_stats();
+    assert(detailed.workers.size() == 4);
+
+    // every executed task lands in exactly one wait bucket and one run bucket
+    uint64_t wait_total = 0;
+    uint64_t run_total = 0;
+    for (const auto& worker : detailed.workers) {
+        for (uint64_t count : worker.wait_hist) {
+            wait_total += count;
+        }
+        for (uint64_t count : worker.run_hist) {
+            run_total += count;
+        }
+        assert(worker.steal_attempts >= worker.steal_successes);
+    }
+    assert(wait_total == n);
+    assert(run_total == n);
+
+    // off by default: depths still readable, histograms stay zero
+    ThreadPool plain(2);
+    plain.submit([]() { return 1; }).get();
+    auto quiet = plain.get_detailed_stats();
+    assert(quiet.workers.size() == 2);
+    for (const auto& worker : quiet.workers) {
+        for (uint64_t count : worker.wait_hist) {
+            assert(count == 0);
+        }
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void test_low_priority_lane() {
+    std::cout << "test 23: low priority lane ";
+
+    // single worker, gated behind a blocker, so the drain order is
+    // deterministic: MEDIUM first, one LOW every low_ratio tasks
+    {
+        ThreadPool pool(1);
+
+        std::atomic<bool> gate{false};
+        std::atomic<bool> blocked{false};
+        pool.post([&gate, &blocked]() {
+            blocked = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        // make sure the worker is pinned on the blocker before the
+        // backlog goes in, otherwise the drain order is racy
+        while (!blocked) {
+            std::this_thread::yield();
+        }
+
+        std::vector<int> order;
+        std::mutex order_mutex;
+        for (int i = 0; i < 16; ++i) {
+            pool.post(Priority::LOW, [&order, &order_mutex]() {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(2);
+            });
+        }
+        for (int i = 0; i < 16; ++i) {
+            pool.post(Priority::MEDIUM, [&order, &order_mutex]() {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(1);
+            });
+        }
+
+        gate = true;
+        pool.wait_all();
+
+        assert(order.size() == 32);
+        size_t first_low = 0;
+        while (first_low < order.size() && order[first_low] == 1) {
+            first_low++;
+        }
+        // LOW queues behind MEDIUM but the ratio lets it through before
+        // the MEDIUM backlog fully drains
+        assert(first_low >= 4);
+        assert(first_low < 16);
+        assert(order.back() == 2);
+    }
+
+    // strict mode: low_ratio 0 means LOW only runs once MEDIUM is dry
+    {
+        ThreadPool::Options options;
+        options.low_ratio = 0;
+        ThreadPool pool(1, options);
+
+        std::atomic<bool> gate{false};
+        std::atomic<bool> blocked{false};
+        pool.post([&gate, &blocked]() {
+            blocked = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        // make sure the worker is pinned on the blocker before the
+        // backlog goes in, otherwise the drain order is racy
+        while (!blocked) {
+            std::this_thread::yield();
+        }
+
+        std::vector<int> order;
+        std::mutex order_mutex;
+        for (int i = 0; i < 8; ++i) {
+            pool.post(Priority::LOW, [&order, &order_mutex]() {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(2);
+            });
+            pool.post(Priority::MEDIUM, [&order, &order_mutex]() {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(1);
+            });
+        }
+
+        gate = true;
+        pool.wait_all();
+
+        assert(order.size() == 16);
+        for (size_t i = 0; i < 8; ++i) {
+            assert(order[i] == 1);
+        }
+        for (size_t i = 8; i < 16; ++i) {
+            assert(order[i] == 2);
+        }
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void test_fail_fast() {
+    std::cout << "test 24: fail fast ";
+
+    ThreadPool::Options options;
+    options.fail_fast = true;
+    ThreadPool pool(2, options);
+
+    std::atomic<int> errors{0};
+    pool.set_exception_handler([&errors](std::exception_ptr) { errors++; });
+
+    pool.post([]() {
+        throw std::runtime_error("poisoned task");
+    });
+
+    // the trip races this loop; eventually the pool rejects new work
+    bool rejected = false;
+    for (int i = 0; i < 2000 && !rejected; ++i) {
+        try {
+            pool.post([]() {});
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    assert(rejected);
+    assert(errors == 1);
+
+    // wait_all must not hang on the backlog the trip abandoned
+    pool.wait_all();
+    pool.shutdown_immediate();
+
+    std::cout << "PASSED\n";
+}
+
+void test_deadline_lane() {
+    std::cout << "test 25: deadline lane ";
+
+    ThreadPool pool(1);
+
+    // pin the worker so the heap fills up before anything is popped
+    std::atomic<bool> gate{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&gate, &blocked]() {
+        blocked = true;
+        while (!gate) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked) {
+        std::this_thread::yield();
+    }
+
+    std::vector<int> order;
+    std::mutex order_mutex;
+    auto record = [&order, &order_mutex](int v) {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(v);
+    };
+
+    // deadlines are generous so nothing live gets shed on a slow box;
+    // EDF only decides the pop order
+    auto now = std::chrono::steady_clock::now();
+    auto f2 = pool.submit_with_deadline(now + std::chrono::seconds(10), record, 2);
+    auto f3 = pool.submit_with_deadline(now + std::chrono::seconds(15), record, 3);
+    auto f1 = pool.submit_with_deadline(now + std::chrono::seconds(5), record, 1);
+    auto expired = pool.submit_with_deadline(
+        now - std::chrono::milliseconds(1), []() { return 7; });
+
+    gate = true;
+    f1.get();
+    f2.get();
+    f3.get();
+
+    assert(order.size() == 3);
+    assert(order[0] == 1 && order[1] == 2 && order[2] == 3);
+
+    // the expired task was shed: broken promise, counted, and the
+    // pending aggregate still drains
+    bool threw = false;
+    try {
+        expired.get();
+    } catch (const std::future_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(pool.get_stats().tasks_shed == 1);
+    pool.wait_all();
+
+    // a shed must not masquerade as a completion: the in-flight and
+    // pending aggregates have to land on exactly zero, not wrap
+    assert(pool.active_tasks() == 0);
+    assert(pool.pending_tasks() == 0);
+
+    std::cout << "PASSED\n";
+}
+
+void test_fork_join() {
+    std::cout << "test 26: fork join ";
+
+    // one worker: without help-first joins the root would block waiting
+    // on children stuck behind it in its own deque and deadlock
+    ThreadPool pool(1);
+
+    std::atomic<int> leaves{0};
+    std::function<void(int)> node = [&pool, &leaves, &node](int depth) {
+        if (depth == 0) {
+            leaves++;
+            return;
+        }
+        TaskGroup group(pool);
+        group.run([&node, depth]() { node(depth - 1); });
+        group.run([&node, depth]() { node(depth - 1); });
+        group.wait();
+    };
+
+    pool.submit(node, 10).get();
+    assert(leaves == 1024);
+
+    // exceptions still propagate out of nested waits
+    bool threw = false;
+    try {
+        pool.submit([&pool]() {
+            TaskGroup group(pool);
+            group.run([]() { throw std::runtime_error("child failed"); });
+            group.wait();
+        }).get();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "PASSED\n";
+}
+
+void test_lazy_spawn_and_drain() {
+    std::cout << "test 27: lazy spawn and drain ";
+
+    // lazy pool: no threads until the first submit
+    {
+        ThreadPool::Options options;
+        options.lazy_spawn = true;
+        ThreadPool pool(2, options);
+        assert(pool.num_threads() == 0);
+
+        assert(pool.submit([]() { return 9; }).get() == 9);
+        assert(pool.num_threads() == 2);
+    }
+
+    // a pool that is never used must tear down without ever spawning
+    {
+        ThreadPool::Options options;
+        options.lazy_spawn = true;
+        ThreadPool pool(8, options);
+        assert(pool.num_threads() == 0);
+    }
+
+    // drain handoff: source worker is pinned, backlog moves wholesale
+    {
+        ThreadPool source(1);
+        ThreadPool sink(2);
+
+        std::atomic<bool> gate{false};
+        std::atomic<bool> blocked{false};
+        source.post([&gate, &blocked]() {
+            blocked = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        while (!blocked) {
+            std::this_thread::yield();
+        }
+
+        std::atomic<int> count{0};
+        for (int i = 0; i < 50; ++i) {
+            source.post([&count]() { count++; });
+        }
+        auto pending_future = source.submit_with_deadline(
+            std::chrono::steady_clock::now() + std::chrono::hours(1),
+            []() { return 11; });
+
+        std::thread drainer([&source, &sink]() { source.drain_to(sink); });
+        gate = true;
+        drainer.join();
+
+        sink.wait_all();
+        assert(count == 50);
+        assert(pending_future.get() == 11);
+        assert(source.pending_tasks() == 0);
+    }
+
+    std::cout << "PASSED\n";
+}
+
+namespace {
+
+// single worker pinned on a blocker so admission sees a stable backlog
+struct GatedPool {
+    ThreadPool pool;
+    std::atomic<bool> gate{false};
+
+    explicit GatedPool(const ThreadPool::Options& options) : pool(1, options) {
+        std::atomic<bool> blocked{false};
+        pool.post([this, &blocked]() {
+            blocked = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        while (!blocked) {
+            std::this_thread::yield();
+        }
+    }
+
+    void release() { gate = true; }
+};
+
+}
+
+void test_admission_control() {
+    std::cout << "test 28: admission control ";
+
+    // reject: the cap counts the running blocker, so two posts fit
+    {
+        ThreadPool::Options options;
+        options.max_pending = 3;
+        options.overflow_policy = ThreadPool::OverflowPolicy::REJECT;
+        GatedPool gated(options);
+
+        gated.pool.post([]() {});
+        gated.pool.post([]() {});
+        bool rejected = false;
+        try {
+            gated.pool.post([]() {});
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        assert(rejected);
+
+        // the cap holds at every external entry point, not just post
+        rejected = false;
+        try {
+            gated.pool.submit_with_key(7, []() {});
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        assert(rejected);
+        rejected = false;
+        try {
+            gated.pool.submit_with_deadline(
+                std::chrono::steady_clock::now() + std::chrono::seconds(5), []() {});
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        assert(rejected);
+
+        gated.release();
+        gated.pool.wait_all();
+        auto stats = gated.pool.get_stats();
+        assert(stats.peak_pending == 3);
+    }
+
+    // drop-oldest: the first queued task is evicted to admit the last
+    {
+        ThreadPool::Options options;
+        options.max_pending = 2;
+        options.overflow_policy = ThreadPool::OverflowPolicy::DROP_OLDEST;
+        GatedPool gated(options);
+
+        std::atomic<bool> ran_first{false};
+        std::atomic<bool> ran_second{false};
+        gated.pool.post([&ran_first]() { ran_first = true; });
+        gated.pool.post([&ran_second]() { ran_second = true; });
+
+        gated.release();
+        gated.pool.wait_all();
+        assert(!ran_first);
+        assert(ran_second);
+        assert(gated.pool.get_stats().tasks_dropped == 1);
+        // same zero-not-wrap guarantee for the drop path
+        assert(gated.pool.active_tasks() == 0);
+        assert(gated.pool.pending_tasks() == 0);
+    }
+
+    // caller-runs: the overflowing post executes on the submitter
+    {
+        ThreadPool::Options options;
+        options.max_pending = 2;
+        options.overflow_policy = ThreadPool::OverflowPolicy::CALLER_RUNS;
+        GatedPool gated(options);
+
+        std::thread::id inline_thread;
+        gated.pool.post([]() {});
+        gated.pool.post([&inline_thread]() {
+            inline_thread = std::this_thread::get_id();
+        });
+        assert(inline_thread == std::this_thread::get_id());
+
+        gated.release();
+        gated.pool.wait_all();
+    }
+
+    // block: the submitter parks until a completion frees room
+    {
+        ThreadPool::Options options;
+        options.max_pending = 2;
+        options.overflow_policy = ThreadPool::OverflowPolicy::BLOCK;
+        GatedPool gated(options);
+
+        std::atomic<int> count{0};
+        gated.pool.post([&count]() { count++; });
+
+        std::atomic<bool> submitted{false};
+        std::thread producer([&gated, &count, &submitted]() {
+            gated.pool.post([&count]() { count++; });
+            submitted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        assert(!submitted);
+
+        gated.release();
+        producer.join();
+        gated.pool.wait_all();
+        assert(count == 2);
+    }
+
+    std::cout << "PASSED\n";
+}
+
+void test_keyed_submission() {
+    std::cout << "test 29: keyed submission ";
+
+    // equal keys must run in submission order and never concurrently,
+    // even when idle workers lift keyed tasks as a last resort
+    {
+        ThreadPool pool(4);
+
+        constexpr int keys = 8;
+        constexpr int per_key = 50;
+        std::vector<std::vector<int>> orders(keys);
+        std::mutex order_mutex[keys];
+        std::atomic<int> running[keys] = {};
+        std::atomic<bool> overlapped{false};
+
+        for (int i = 0; i < per_key; ++i) {
+            for (int k = 0; k < keys; ++k) {
+                pool.submit_with_key(static_cast<uint64_t>(k), [&, k, i]() {
+                    if (running[k].fetch_add(1) != 0) {
+                        overlapped = true;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(order_mutex[k]);
+                        orders[k].push_back(i);
+                    }
+                    running[k].fetch_sub(1);
+                });
+            }
+        }
+        pool.wait_all();
+
+        assert(!overlapped);
+        for (int k = 0; k < keys; ++k) {
+            assert(orders[k].size() == per_key);
+            for (int i = 0; i < per_key; ++i) {
+                assert(orders[k][i] == i);
+            }
+        }
+
+        auto stats = pool.get_stats();
+        assert(stats.tasks_completed == keys * per_key);
+    }
+
+    // a single-worker pool is the degenerate case: everything is home
+    // traffic, results flow back through the futures
+    {
+        ThreadPool pool(1);
+        auto future = pool.submit_with_key(42, [](int a, int b) { return a * b; }, 6, 7);
+        assert(future.get() == 42);
+        pool.wait_all();
+    }
+
+    std::cout << "PASSED\n";
+}
+
 int main() {
     std::cout << "Test suite\n";
-    
+
     try {
         test_basic_submission();
         test_multiple_tasks();
@@ -158,7 +1077,28 @@ int main() {
         test_statistics();
         test_shutdown_graceful();
         test_shutdown_immediate();
-        
+        test_submit_bulk();
+        test_parallel_for_reduce();
+        test_post();
+        test_affinity_options();
+        test_continuations();
+        test_elastic_sizing();
+        test_worker_local_submit();
+        test_task_group();
+        test_coroutines();
+        test_steal_batching();
+        test_timers();
+        test_arena_churn();
+        test_pipeline();
+        test_instrumentation();
+        test_low_priority_lane();
+        test_fail_fast();
+        test_deadline_lane();
+        test_fork_join();
+        test_lazy_spawn_and_drain();
+        test_admission_control();
+        test_keyed_submission();
+
         std::cout << "ALL TESTS PASSED\n";
         
         return 0;
@@ -1,135 +1,1039 @@
 #include "thread_pool.h"
 #include <iostream>
 #include <algorithm>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <map>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// best effort: the package id of a cpu stands in for its NUMA node when
+// the caller did not say how many nodes there are
+int detect_package(int cpu) {
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                       "/topology/physical_package_id");
+    int package = 0;
+    if (!(file >> package)) {
+        return 0;
+    }
+    return package;
+}
+
+}
 
 ThreadPool::ThreadPool(size_t num_threads)
-    : stop_(false)
+    : ThreadPool(num_threads, Options{}) {
+}
+
+ThreadPool::ThreadPool(size_t num_threads, const Options& options)
+    : options_(options)
+    , min_threads_(options.min_threads == 0 ? num_threads : options.min_threads)
+    , max_threads_(options.max_threads == 0 ? num_threads : options.max_threads)
+    , active_target_(std::max(min_threads_, std::min(num_threads, max_threads_)))
+    , stop_(false)
     , immediate_stop_(false)
-    , active_tasks_(0)
-    , pending_tasks_(0)
-    , tasks_completed_(0)
-    , tasks_stolen_(0)
-    , total_tasks_submitted_(0)
-    , gen_(rd_()) {
-    
+    , next_queue_(0) {
+
     if (num_threads == 0) {
         throw std::invalid_argument("Thread pool must have at least one thread");
     }
-    
-    for (size_t i = 0; i < num_threads; ++i) {
-        local_queues_.emplace_back(std::make_unique<WorkStealingQueue>());
+    if (min_threads_ == 0 || min_threads_ > max_threads_) {
+        throw std::invalid_argument("Thread pool bounds must satisfy 1 <= min <= max");
     }
-    
-    for (size_t i = 0; i < num_threads; ++i) {
+
+    // all max_threads_ threads are created once up front; in elastic
+    // mode the ones above the active target park immediately and cost
+    // only a notify to re-attach
+    size_t pool_size = max_threads_;
+
+    worker_blocks_.reset(new WorkerBlock[pool_size]);
+    // each worker steals with its own engine; one seed per block, the
+    // device is only touched here
+    std::random_device rd;
+    for (size_t i = 0; i < pool_size; ++i) {
+        worker_blocks_[i].rng.seed(rd());
+    }
+    if (options_.enable_instrumentation) {
+        metrics_.reset(new WorkerMetrics[pool_size]);
+    }
+
+    // decide which cpu each worker would be pinned to
+    pinned_cpu_.assign(pool_size, -1);
+    if (options_.pin_threads) {
+        unsigned hw = std::thread::hardware_concurrency();
+        if (hw == 0) {
+            hw = 1;
+        }
+        for (size_t i = 0; i < pool_size; ++i) {
+            pinned_cpu_[i] = options_.cpu_ids.empty()
+                ? static_cast<int>(i % hw)
+                : options_.cpu_ids[i % options_.cpu_ids.size()];
+        }
+    }
+
+    // map workers onto nodes: explicit count gets contiguous blocks,
+    // otherwise group pinned workers by physical package id
+    worker_node_.assign(pool_size, 0);
+    if (options_.numa_nodes > 0) {
+        for (size_t i = 0; i < pool_size; ++i) {
+            worker_node_[i] = i * options_.numa_nodes / pool_size;
+        }
+    } else if (options_.pin_threads) {
+        std::map<int, size_t> package_to_node;
+        for (size_t i = 0; i < pool_size; ++i) {
+            int package = detect_package(pinned_cpu_[i]);
+            auto it = package_to_node.find(package);
+            if (it == package_to_node.end()) {
+                it = package_to_node.emplace(package, package_to_node.size()).first;
+            }
+            worker_node_[i] = it->second;
+        }
+    }
+
+    size_t nodes = 0;
+    for (size_t i = 0; i < pool_size; ++i) {
+        nodes = std::max(nodes, worker_node_[i] + 1);
+    }
+    node_workers_.resize(nodes);
+    for (size_t i = 0; i < pool_size; ++i) {
+        node_workers_[worker_node_[i]].push_back(i);
+    }
+    node_rr_.reset(new std::atomic<size_t>[nodes]);
+    for (size_t i = 0; i < nodes; ++i) {
+        node_rr_[i].store(0);
+    }
+
+    if (!options_.lazy_spawn) {
+        spawn_workers();
+    }
+}
+
+void ThreadPool::ensure_spawned() {
+    if (spawned_.load(std::memory_order_acquire)) {
+        return;
+    }
+    spawn_workers();
+}
+
+void ThreadPool::spawn_workers() {
+    std::lock_guard<std::mutex> lock(spawn_mutex_);
+    if (spawned_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    size_t pool_size = max_threads_;
+
+    for (size_t i = 0; i < pool_size; ++i) {
         workers_.emplace_back([this, i] { worker_thread(i); });
     }
+
+#ifdef __linux__
+    if (options_.pin_threads) {
+        for (size_t i = 0; i < pool_size; ++i) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(pinned_cpu_[i], &set);
+            pthread_setaffinity_np(workers_[i].native_handle(), sizeof(set), &set);
+        }
+    }
+#endif
+
+    if (max_threads_ > min_threads_) {
+        controller_ = std::thread([this] { controller_thread(); });
+    }
+
+    spawned_.store(true, std::memory_order_release);
 }
 
 ThreadPool::~ThreadPool() {
     shutdown_graceful();
 }
 
+std::mutex TaskArena::cache_mutex_;
+std::vector<TaskArena*> TaskArena::cache_;
+
+thread_local ThreadPool::WorkerIdentity ThreadPool::current_worker_{nullptr, 0};
+
 void ThreadPool::worker_thread(size_t thread_id) {
+    current_worker_ = {this, thread_id};
+
+    // spin this many times before parking; keeps handoff latency in the
+    // microsecond range when tasks arrive back to back
+    constexpr int SPIN_ROUNDS = 64;
+
     while (true) {
-        std::function<void()> task;
-        
+        // immediate mode stops intake here, before the next pop, so a
+        // drain_to handoff finds the backlog still queued
+        if (immediate_stop_) {
+            break;
+        }
+
+        // elastic mode: workers above the active target hand off their
+        // queue and park on the dormant event count; re-attach is just
+        // the controller's notify, no thread creation involved
+        if (thread_id >= active_target_.load(std::memory_order_relaxed)) {
+            if (stop_ || immediate_stop_) {
+                break;
+            }
+            retire_worker(thread_id);
+            uint64_t ticket = dormant_parking_.prepare_wait();
+            if (stop_ || immediate_stop_ ||
+                thread_id < active_target_.load(std::memory_order_relaxed)) {
+                dormant_parking_.cancel_wait();
+            } else {
+                dormant_parking_.wait(ticket);
+            }
+            continue;
+        }
+
+        Task task;
+
         if (get_task(thread_id, task)) {
+            worker_blocks_[thread_id].counters.started.fetch_add(1, std::memory_order_relaxed);
+            task();
+            finish_task(thread_id);
+            continue;
+        }
+
+        if (immediate_stop_) {
+            break;
+        }
+
+        if (stop_ && pending_tasks() == 0) {
+            break;
+        }
+
+        // fire any due timers into our own queue before spinning
+        service_timers();
+
+        bool found = false;
+        for (int spin = 0; spin < SPIN_ROUNDS && !found; ++spin) {
+            std::this_thread::yield();
+            found = get_task(thread_id, task);
+        }
+
+        if (found) {
+            worker_blocks_[thread_id].counters.started.fetch_add(1, std::memory_order_relaxed);
             task();
+            finish_task(thread_id);
+            continue;
+        }
+
+        // announce the park, re-check, then sleep until a submit or the
+        // shutdown path bumps the event count
+        uint64_t ticket = parking_.prepare_wait();
+        if (immediate_stop_ || (stop_ && pending_tasks() == 0) || has_queued_work()) {
+            parking_.cancel_wait();
+            continue;
+        }
+        // the deadline is re-read after prepare_wait so a timer armed in
+        // between cannot slip past the park
+        std::chrono::steady_clock::time_point next_deadline;
+        if (next_timer_deadline(next_deadline)) {
+            parking_.wait_until(ticket, next_deadline);
         } else {
-            if (immediate_stop_) {
-                break;
+            parking_.wait(ticket);
+        }
+    }
+}
+
+void ThreadPool::controller_thread() {
+    // coarse tick: scale decisions are not latency sensitive, only the
+    // re-attach notify is. backlog has to persist for a couple of ticks
+    // before we grow; idle has to persist much longer before we retire,
+    // so a diurnal trough shrinks the pool but a brief gap does not
+    constexpr auto TICK = std::chrono::milliseconds(2);
+    constexpr size_t BACKLOG_FACTOR = 2;
+    constexpr size_t GROW_TICKS = 2;
+    constexpr size_t RETIRE_TICKS = 50;
+
+    size_t busy_ticks = 0;
+    size_t idle_ticks = 0;
+
+    while (!stop_) {
+        std::this_thread::sleep_for(TICK);
+        if (stop_) {
+            break;
+        }
+
+        size_t active = active_target_.load(std::memory_order_relaxed);
+        size_t pending = pending_tasks();
+
+        if (pending > active * BACKLOG_FACTOR && active < max_threads_) {
+            idle_ticks = 0;
+            if (++busy_ticks >= GROW_TICKS) {
+                busy_ticks = 0;
+                active_target_.store(active + 1, std::memory_order_relaxed);
+                dormant_parking_.notify_all();
             }
-            
-            if (stop_ && pending_tasks_ == 0) {
-                break;
+        } else if (pending == 0 && active > min_threads_) {
+            busy_ticks = 0;
+            if (++idle_ticks >= RETIRE_TICKS) {
+                idle_ticks = 0;
+                active_target_.store(active - 1, std::memory_order_relaxed);
+                // wake the retiring worker so it notices and parks
+                parking_.notify_all();
             }
-            
-            std::unique_lock<std::mutex> lock(global_mutex_);
-            global_cv_.wait_for(lock, std::chrono::milliseconds(10), [this] {
-                return stop_ || immediate_stop_ || !global_queue_.empty() || pending_tasks_ > 0;
-            });
-            
-            if (immediate_stop_) {
-                break;
+        } else {
+            busy_ticks = 0;
+            idle_ticks = 0;
+        }
+    }
+}
+
+void ThreadPool::retire_worker(size_t thread_id) {
+    // queued work was accounted at submit time, so handing it to an
+    // active sibling is a plain move with no counter traffic
+    Task task;
+    bool moved = false;
+    while (worker_blocks_[thread_id].queue.pop(task)) {
+        size_t target = pick_queue();
+        worker_blocks_[target].queue.push(std::move(task));
+        moved = true;
+    }
+    while (worker_blocks_[thread_id].low_queue.pop(task)) {
+        size_t target = pick_queue();
+        worker_blocks_[target].low_queue.push(std::move(task));
+        moved = true;
+    }
+    // keyed tasks stay on their home lane: moving them would break the
+    // stable key mapping. active workers raid the dormant lane as a last
+    // resort, so wake one if there is a backlog.
+    if (worker_blocks_[thread_id].keyed.size.load(std::memory_order_relaxed) != 0) {
+        moved = true;
+    }
+    if (moved) {
+        parking_.notify_all();
+    }
+}
+
+size_t ThreadPool::pick_queue() {
+    return next_queue_++ % active_target_.load(std::memory_order_relaxed);
+}
+
+bool ThreadPool::has_queued_work() const {
+    if (!lanes_.empty()) {
+        return true;
+    }
+
+    if (deadline_count_.load(std::memory_order_relaxed) != 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < max_threads_; ++i) {
+        if (!worker_blocks_[i].queue.empty() || !worker_blocks_[i].low_queue.empty() ||
+            worker_blocks_[i].keyed.size.load(std::memory_order_relaxed) != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::finish_task(size_t thread_id) {
+    worker_blocks_[thread_id].counters.completed.fetch_add(1, std::memory_order_seq_cst);
+    // completions only touch the cv machinery when a waiter registered
+    // and the pool just drained; the common case is a single load of the
+    // waiter gate. registration bumps the gate before reading the
+    // counters, so either we see the waiter here or it sees our
+    // completion and never sleeps.
+    if (wait_waiters_.load(std::memory_order_seq_cst) > 0 && pending_tasks() == 0) {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        wait_cv_.notify_all();
+    }
+    // submitters blocked on admission wake on any completion; the gate
+    // keeps this off the hot path for unbounded pools
+    if (admission_waiters_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        wait_cv_.notify_all();
+    }
+    // a graceful shutdown may have workers parked waiting for the last
+    // in-flight task; the finisher has to wake them up
+    if (stop_ && pending_tasks() == 0) {
+        parking_.notify_all();
+    }
+}
+
+void ThreadPool::enqueue_ready(Task task) {
+    enqueue_task(std::move(task));
+}
+
+size_t ThreadPool::hist_bucket(uint64_t ns) {
+    size_t bucket = std::bit_width(ns | 1);
+    return bucket >= HIST_BUCKETS ? HIST_BUCKETS - 1 : bucket;
+}
+
+Task ThreadPool::maybe_instrument(Task task) {
+    if (!metrics_) {
+        return task;
+    }
+    auto enqueued = std::chrono::steady_clock::now();
+    return Task([this, enqueued, inner = std::move(task)]() mutable {
+        auto start = std::chrono::steady_clock::now();
+        WorkerMetrics& metrics = metrics_[current_worker_.id];
+        uint64_t waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            start - enqueued).count();
+        metrics.wait_hist[hist_bucket(waited)].fetch_add(1, std::memory_order_relaxed);
+
+        inner();
+
+        uint64_t ran = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        metrics.run_hist[hist_bucket(ran)].fetch_add(1, std::memory_order_relaxed);
+    });
+}
+
+bool ThreadPool::admit(Task& task) {
+    if (options_.max_pending == 0) {
+        return true;
+    }
+    // a worker subdividing its own work is never throttled: blocking it
+    // deadlocks, and its children shrink the backlog it came from
+    if (current_worker_.pool == this) {
+        return true;
+    }
+
+    size_t pending = pending_tasks();
+    if (pending >= options_.max_pending) {
+        switch (options_.overflow_policy) {
+        case OverflowPolicy::BLOCK: {
+            admission_waiters_.fetch_add(1, std::memory_order_seq_cst);
+            {
+                std::unique_lock<std::mutex> lock(wait_mutex_);
+                wait_cv_.wait(lock, [this] {
+                    return stop_ || immediate_stop_ ||
+                           pending_tasks() < options_.max_pending;
+                });
             }
-            
-            if (stop_ && pending_tasks_ == 0) {
-                break;
+            admission_waiters_.fetch_sub(1, std::memory_order_seq_cst);
+            pending = pending_tasks();
+            break;
+        }
+        case OverflowPolicy::REJECT:
+            throw std::runtime_error("Thread pool queue is full");
+        case OverflowPolicy::DROP_OLDEST: {
+            // evict one queued task to make room; LOW lanes first, they
+            // are the least valuable backlog. the victim was counted at
+            // submit, so a disposal credit drains the aggregate.
+            Task victim;
+            for (size_t i = 0; i < max_threads_; ++i) {
+                if (worker_blocks_[i].low_queue.try_evict(victim) ||
+                    worker_blocks_[i].queue.try_evict(victim)) {
+                    worker_blocks_[i].counters.dropped.fetch_add(1, std::memory_order_relaxed);
+                    worker_blocks_[i].counters.disposed.fetch_add(1, std::memory_order_seq_cst);
+                    break;
+                }
             }
+            // nothing evictable means the backlog is all in flight;
+            // admit rather than stall a telemetry producer
+            break;
         }
+        case OverflowPolicy::CALLER_RUNS:
+            // natural backpressure: the producer becomes the consumer,
+            // which keeps queues short and the data cache-resident
+            task();
+            return false;
+        }
+    }
+
+    // maintained only on the bounded path, where pending was computed
+    // anyway; the unbounded pool never pays the shard scan
+    size_t observed = pending + 1;
+    size_t peak = peak_pending_.load(std::memory_order_relaxed);
+    while (observed > peak &&
+           !peak_pending_.compare_exchange_weak(peak, observed, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void ThreadPool::enqueue_task(Task task) {
+    ensure_spawned();
+    if (!admit(task)) {
+        return;
+    }
+    task = maybe_instrument(std::move(task));
+    if (current_worker_.pool == this) {
+        // spawned from inside the pool: the child's data is hot in this
+        // worker's cache, so it goes straight onto our own deque bottom
+        size_t thread_id = current_worker_.id;
+        worker_blocks_[thread_id].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+        worker_blocks_[thread_id].queue.push_local(std::move(task));
+    } else {
+        size_t thread_id = pick_queue();
+        worker_blocks_[thread_id].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+        worker_blocks_[thread_id].queue.push(std::move(task));
     }
+    parking_.notify_one();
 }
 
-bool ThreadPool::get_task(size_t thread_id, std::function<void()>& task) {
+void ThreadPool::enqueue_task(Priority priority, Task task) {
+    ensure_spawned();
+    if (priority == Priority::HIGH) {
+        if (!admit(task)) {
+            return;
+        }
+        worker_blocks_[pick_queue()].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+        lanes_.push(priority, maybe_instrument(std::move(task)));
+        parking_.notify_one();
+    } else if (priority == Priority::LOW) {
+        if (!admit(task)) {
+            return;
+        }
+        // LOW gets its own per-worker lane so it queues behind MEDIUM
+        // instead of competing head to head in the same deque
+        task = maybe_instrument(std::move(task));
+        if (current_worker_.pool == this) {
+            size_t thread_id = current_worker_.id;
+            worker_blocks_[thread_id].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+            worker_blocks_[thread_id].low_queue.push_local(std::move(task));
+        } else {
+            size_t thread_id = pick_queue();
+            worker_blocks_[thread_id].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+            worker_blocks_[thread_id].low_queue.push(std::move(task));
+        }
+        parking_.notify_one();
+    } else {
+        enqueue_task(std::move(task));
+    }
+}
+
+void ThreadPool::add_timer(std::chrono::steady_clock::time_point deadline, Task task) {
+    ensure_spawned();
     {
-        std::lock_guard<std::mutex> lock(global_mutex_);
-        if (!global_queue_.empty()) {
-            task = std::move(global_queue_.top().task);
-            global_queue_.pop();
-            return true;
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        timers_.push_back(TimerEntry{deadline, std::move(task)});
+        std::push_heap(timers_.begin(), timers_.end(), TimerLater{});
+    }
+    timer_count_.fetch_add(1, std::memory_order_relaxed);
+    // a parked worker re-derives its sleep bound from the new heap top
+    parking_.notify_one();
+}
+
+void ThreadPool::service_timers() {
+    if (timer_count_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    std::vector<Task> due;
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        while (!timers_.empty() && timers_.front().deadline <= now) {
+            std::pop_heap(timers_.begin(), timers_.end(), TimerLater{});
+            due.push_back(std::move(timers_.back().task));
+            timers_.pop_back();
         }
     }
-    
-    if (local_queues_[thread_id]->pop(task)) {
+
+    if (!due.empty()) {
+        timer_count_.fetch_sub(due.size(), std::memory_order_relaxed);
+        // accounting happens here, not at arm time, so wait_all only
+        // covers timers that actually fired
+        for (Task& task : due) {
+            enqueue_task(std::move(task));
+        }
+    }
+}
+
+bool ThreadPool::next_timer_deadline(std::chrono::steady_clock::time_point& next) const {
+    if (timer_count_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    if (timers_.empty()) {
+        return false;
+    }
+    next = timers_.front().deadline;
+    return true;
+}
+
+void ThreadPool::add_deadline_task(std::chrono::steady_clock::time_point deadline, Task task) {
+    ensure_spawned();
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex_);
+        deadline_heap_.push_back(TimerEntry{deadline, std::move(task)});
+        std::push_heap(deadline_heap_.begin(), deadline_heap_.end(), TimerLater{});
+    }
+    deadline_count_.fetch_add(1, std::memory_order_relaxed);
+    parking_.notify_one();
+}
+
+bool ThreadPool::pop_deadline_task(size_t thread_id, Task& task) {
+    if (deadline_count_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    size_t shed = 0;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex_);
+        auto now = std::chrono::steady_clock::now();
+        while (!deadline_heap_.empty()) {
+            std::pop_heap(deadline_heap_.begin(), deadline_heap_.end(), TimerLater{});
+            if (deadline_heap_.back().deadline < now) {
+                // past deadline: running it would burn cpu on a result
+                // nobody reads. dropping the packaged task breaks its
+                // promise, so a waiting future reports the shed.
+                deadline_heap_.pop_back();
+                shed++;
+                continue;
+            }
+            task = std::move(deadline_heap_.back().task);
+            deadline_heap_.pop_back();
+            found = true;
+            break;
+        }
+    }
+
+    size_t taken = shed + (found ? 1 : 0);
+    if (taken > 0) {
+        deadline_count_.fetch_sub(taken, std::memory_order_relaxed);
+    }
+    if (shed > 0) {
+        CounterShard& counters = worker_blocks_[thread_id].counters;
+        counters.shed.fetch_add(shed, std::memory_order_relaxed);
+        // shed tasks credit disposed so the pending aggregate drains,
+        // and a wait_all blocked on them gets the same wakeup a normal
+        // completion would give
+        counters.disposed.fetch_add(shed, std::memory_order_seq_cst);
+        if (wait_waiters_.load(std::memory_order_seq_cst) > 0 && pending_tasks() == 0) {
+            std::lock_guard<std::mutex> lock(wait_mutex_);
+            wait_cv_.notify_all();
+        }
+    }
+    return found;
+}
+
+void ThreadPool::enqueue_keyed(uint64_t key, Task task) {
+    ensure_spawned();
+    // the home worker is a pure function of the key over the full worker
+    // set, so the mapping never shifts when the controller resizes. the
+    // fibonacci multiplier spreads stride-patterned keys that a plain
+    // modulo would pile onto one worker.
+    size_t target = (key * 0x9E3779B97F4A7C15ull) % max_threads_;
+    KeyedLane& lane = worker_blocks_[target].keyed;
+
+    // keyed work obeys the same cap as everything else, with one
+    // wrinkle: CALLER_RUNS may only run inline while the key is
+    // completely idle, or the inline run would jump ahead of the key's
+    // queued backlog. a busy key at the cap is admitted anyway -- the
+    // same concession DROP_OLDEST makes when nothing is evictable.
+    bool key_busy = false;
+    if (options_.max_pending != 0 &&
+        options_.overflow_policy == OverflowPolicy::CALLER_RUNS) {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        key_busy = lane.running && lane.running_key == key;
+        if (!key_busy) {
+            key_busy = std::find(lane.stolen_keys.begin(), lane.stolen_keys.end(),
+                                 key) != lane.stolen_keys.end();
+        }
+        for (auto it = lane.tasks.begin(); !key_busy && it != lane.tasks.end(); ++it) {
+            key_busy = it->first == key;
+        }
+    }
+    if (!key_busy && !admit(task)) {
+        return;  // CALLER_RUNS consumed it inline
+    }
+
+    worker_blocks_[target].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        lane.tasks.emplace_back(key, maybe_instrument(std::move(task)));
+    }
+    lane.size.fetch_add(1, std::memory_order_relaxed);
+    parking_.notify_one();
+}
+
+bool ThreadPool::pop_keyed(size_t thread_id, Task& task) {
+    KeyedLane& lane = worker_blocks_[thread_id].keyed;
+    if (lane.size.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    Task inner;
+    bool taken = false;
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        // take the oldest entry whose key is not executing on a thief.
+        // skipping a blocked key keeps per-key order while other keys
+        // flow; any later entry with that key is skipped by the same
+        // test. our own previous keyed task has already cleared its
+        // mark -- the worker runs one task at a time.
+        for (auto it = lane.tasks.begin(); it != lane.tasks.end(); ++it) {
+            if (std::find(lane.stolen_keys.begin(), lane.stolen_keys.end(),
+                          it->first) != lane.stolen_keys.end()) {
+                continue;
+            }
+            inner = std::move(it->second);
+            lane.running_key = it->first;
+            lane.running = true;
+            lane.tasks.erase(it);
+            lane.size.fetch_sub(1, std::memory_order_relaxed);
+            taken = true;
+            break;
+        }
+    }
+    if (!taken) {
+        return false;
+    }
+
+    // the mark comes off the moment the task finishes, symmetric to the
+    // thief's release_key. clearing it at our next pop_keyed would leave
+    // the key unschedulable by idle thieves for as long as this worker
+    // has deque work, since get_task drains the deque first.
+    task = Task([this, thread_id, inner = std::move(inner)]() mutable {
+        try {
+            inner();
+        } catch (...) {
+            clear_running(thread_id);
+            throw;
+        }
+        clear_running(thread_id);
+    });
+    return true;
+}
+
+void ThreadPool::clear_running(size_t thread_id) {
+    KeyedLane& lane = worker_blocks_[thread_id].keyed;
+    bool backlog;
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        lane.running = false;
+        backlog = !lane.tasks.empty();
+    }
+    if (backlog) {
+        // a thief can take this key now
+        parking_.notify_one();
+    }
+}
+
+void ThreadPool::release_key(size_t target, uint64_t key) {
+    KeyedLane& lane = worker_blocks_[target].keyed;
+    bool backlog;
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        auto it = std::find(lane.stolen_keys.begin(), lane.stolen_keys.end(), key);
+        if (it != lane.stolen_keys.end()) {
+            lane.stolen_keys.erase(it);
+        }
+        backlog = !lane.tasks.empty();
+    }
+    if (backlog) {
+        // entries behind the released key just became runnable
+        parking_.notify_one();
+    }
+}
+
+void ThreadPool::set_exception_handler(std::function<void(std::exception_ptr)> handler) {
+    std::lock_guard<std::mutex> lock(handler_mutex_);
+    exception_handler_ = std::move(handler);
+}
+
+void ThreadPool::handle_task_exception(std::exception_ptr error) {
+    std::function<void(std::exception_ptr)> handler;
+    {
+        std::lock_guard<std::mutex> lock(handler_mutex_);
+        handler = exception_handler_;
+    }
+    if (handler) {
+        handler(error);
+    }
+    if (options_.fail_fast) {
+        // trip from the worker itself: flags and wakeups only, the join
+        // and queue drain belong to shutdown_immediate (joining here
+        // would deadlock on our own thread)
+        immediate_stop_ = true;
+        stop_ = true;
+        parking_.notify_all();
+        dormant_parking_.notify_all();
+        // wait_all callers must not sleep on a backlog that will never
+        // drain now
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        wait_cv_.notify_all();
+    }
+}
+
+bool ThreadPool::get_task(size_t thread_id, Task& task) {
+    // priority lanes first; empty() is two relaxed loads per lane so an
+    // unused priority path costs next to nothing here
+    if (lanes_.pop(task)) {
         return true;
     }
-    
+
+    // EDF lane next: tighter deadlines outrank everything in the local
+    // queues, and anything already expired is shed here instead of run
+    if (pop_deadline_task(thread_id, task)) {
+        return true;
+    }
+
+    WorkerBlock& block = worker_blocks_[thread_id];
+
+    // anti-starvation gate: after low_ratio MEDIUM tasks in a row one
+    // LOW task jumps the lane, so backfill keeps trickling through a
+    // saturated pool. since_low is owner-only, no atomics needed.
+    if (options_.low_ratio != 0 && block.since_low >= options_.low_ratio &&
+        block.low_queue.pop(task)) {
+        block.since_low = 0;
+        return true;
+    }
+
+    if (block.queue.pop(task)) {
+        block.since_low++;
+        return true;
+    }
+
+    // keyed work ranks with MEDIUM: it is this worker's own affinity
+    // traffic, just ordered per key instead of LIFO
+    if (pop_keyed(thread_id, task)) {
+        return true;
+    }
+
+    if (block.low_queue.pop(task)) {
+        block.since_low = 0;
+        return true;
+    }
+
     if (try_steal(thread_id, task)) {
-        tasks_stolen_++;
         return true;
     }
-    
+
     return false;
 }
 
-bool ThreadPool::try_steal(size_t thread_id, std::function<void()>& task) {
-    size_t num_threads = workers_.size();
-    
+bool ThreadPool::try_steal(size_t thread_id, Task& task) {
+    // steal-half: one successful raid takes up to this many tasks (still
+    // capped at half the victim's backlog) so bursty imbalance drains in
+    // a few trips instead of one scan-plus-sync round per task
+    constexpr size_t MAX_STEAL_BATCH = 32;
+
+    // max_threads_ is immutable, unlike workers_.size(): an early worker
+    // can reach here while spawn_workers is still appending threads, and
+    // reading the vector then is a race. every block exists up front.
+    size_t num_threads = max_threads_;
+
     if (num_threads == 1) {
         return false;
     }
-    
+
     std::uniform_int_distribution<size_t> dist(0, num_threads - 1);
-    size_t start = dist(gen_);
-    
-    for (size_t i = 0; i < num_threads; ++i) {
-        size_t target = (start + i) % num_threads;
-        
-        if (target == thread_id) {
-            continue;
+    size_t start = dist(worker_blocks_[thread_id].rng);
+    size_t my_node = worker_node_[thread_id];
+
+    // steals respect lanes: every victim's MEDIUM deque is tried before
+    // any LOW deque anywhere, so a thief never promotes backfill while
+    // regular work is still visible. within a lane, scan same-node
+    // victims first so steals stay on the local socket and only cross
+    // the interconnect when the whole node is dry.
+    size_t passes = (node_workers_.size() > 1) ? 2 : 1;
+    for (int lane = 0; lane < 2; ++lane) {
+        for (size_t pass = 0; pass < passes; ++pass) {
+            for (size_t i = 0; i < num_threads; ++i) {
+                size_t target = (start + i) % num_threads;
+
+                if (target == thread_id) {
+                    continue;
+                }
+
+                bool same_node = worker_node_[target] == my_node;
+                if (pass == 0 ? !same_node : same_node) {
+                    continue;
+                }
+
+                if (metrics_) {
+                    metrics_[thread_id].steal_attempts.fetch_add(1, std::memory_order_relaxed);
+                }
+                WorkStealingQueue& victim = lane == 0
+                    ? worker_blocks_[target].queue
+                    : worker_blocks_[target].low_queue;
+                std::vector<Task> batch;
+                size_t got = victim.steal_batch(batch, MAX_STEAL_BATCH);
+                if (got > 0) {
+                    if (metrics_) {
+                        metrics_[thread_id].steal_successes.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    task = std::move(batch[0]);
+                    // the surplus lands on our own same-lane deque where
+                    // we pop it LIFO and siblings can re-steal it
+                    WorkStealingQueue& mine = lane == 0
+                        ? worker_blocks_[thread_id].queue
+                        : worker_blocks_[thread_id].low_queue;
+                    for (size_t k = 1; k < got; ++k) {
+                        mine.push_local(std::move(batch[k]));
+                    }
+                    worker_blocks_[thread_id].counters.stolen.fetch_add(got, std::memory_order_relaxed);
+                    worker_blocks_[thread_id].counters.steal_batches.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
         }
-        
-        if (local_queues_[target]->steal(task)) {
+    }
+
+    // keyed lanes are raided only when every regular lane everywhere is
+    // dry. a thief takes a key's oldest entry and marks the key in
+    // flight on the home lane, so equal keys never run on two threads at
+    // once and never out of order; the completion wrapper releases the
+    // key. one task per raid -- batching would defeat the affinity.
+    for (size_t pass = 0; pass < passes; ++pass) {
+        for (size_t i = 0; i < num_threads; ++i) {
+            size_t target = (start + i) % num_threads;
+
+            if (target == thread_id) {
+                continue;
+            }
+
+            bool same_node = worker_node_[target] == my_node;
+            if (pass == 0 ? !same_node : same_node) {
+                continue;
+            }
+
+            KeyedLane& lane = worker_blocks_[target].keyed;
+            if (lane.size.load(std::memory_order_relaxed) == 0) {
+                continue;
+            }
+
+            if (metrics_) {
+                metrics_[thread_id].steal_attempts.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            Task inner;
+            uint64_t key = 0;
+            bool taken = false;
+            {
+                std::lock_guard<std::mutex> lock(lane.mutex);
+                // the first occurrence of each key scanning from the
+                // front is that key's oldest entry -- the only one that
+                // may leave the lane
+                std::vector<uint64_t> seen;
+                for (auto it = lane.tasks.begin(); it != lane.tasks.end(); ++it) {
+                    uint64_t k = it->first;
+                    if (std::find(seen.begin(), seen.end(), k) != seen.end()) {
+                        continue;
+                    }
+                    seen.push_back(k);
+                    if ((lane.running && lane.running_key == k) ||
+                        std::find(lane.stolen_keys.begin(), lane.stolen_keys.end(),
+                                  k) != lane.stolen_keys.end()) {
+                        continue;
+                    }
+                    inner = std::move(it->second);
+                    key = k;
+                    lane.tasks.erase(it);
+                    lane.size.fetch_sub(1, std::memory_order_relaxed);
+                    lane.stolen_keys.push_back(k);
+                    taken = true;
+                    break;
+                }
+            }
+            if (!taken) {
+                continue;
+            }
+
+            if (metrics_) {
+                metrics_[thread_id].steal_successes.fetch_add(1, std::memory_order_relaxed);
+            }
+            task = Task([this, target, key, inner = std::move(inner)]() mutable {
+                try {
+                    inner();
+                } catch (...) {
+                    release_key(target, key);
+                    throw;
+                }
+                release_key(target, key);
+            });
+            worker_blocks_[thread_id].counters.stolen.fetch_add(1, std::memory_order_relaxed);
+            worker_blocks_[thread_id].counters.steal_batches.fetch_add(1, std::memory_order_relaxed);
             return true;
         }
     }
-    
+
     return false;
 }
 
+bool ThreadPool::on_worker_thread() const {
+    return current_worker_.pool == this;
+}
+
+bool ThreadPool::try_run_one() {
+    if (current_worker_.pool != this) {
+        return false;
+    }
+    size_t thread_id = current_worker_.id;
+    Task task;
+    if (!get_task(thread_id, task)) {
+        return false;
+    }
+    worker_blocks_[thread_id].counters.started.fetch_add(1, std::memory_order_relaxed);
+    task();
+    finish_task(thread_id);
+    return true;
+}
+
 void ThreadPool::wait_all() {
-    std::unique_lock<std::mutex> lock(wait_mutex_);
-    wait_cv_.wait(lock, [this] {
-        return pending_tasks_ == 0;
-    });
+    wait_waiters_.fetch_add(1, std::memory_order_seq_cst);
+    {
+        std::unique_lock<std::mutex> lock(wait_mutex_);
+        wait_cv_.wait(lock, [this] {
+            return pending_tasks() == 0 || immediate_stop_;
+        });
+    }
+    wait_waiters_.fetch_sub(1, std::memory_order_seq_cst);
 }
 
+// aggregation reads completed before submitted: any completion we count
+// has its matching submit already visible, so the difference can only
+// overestimate, never go negative or report an early zero
 size_t ThreadPool::active_tasks() const {
-    return active_tasks_.load();
+    size_t completed = 0;
+    for (size_t i = 0; i < max_threads_; ++i) {
+        completed += worker_blocks_[i].counters.completed.load(std::memory_order_seq_cst);
+    }
+    size_t started = 0;
+    for (size_t i = 0; i < max_threads_; ++i) {
+        started += worker_blocks_[i].counters.started.load(std::memory_order_seq_cst);
+    }
+    return started - completed;
 }
 
 size_t ThreadPool::pending_tasks() const {
-    return pending_tasks_.load();
+    // completed and disposed both retire submissions; read them before
+    // submitted for the same overestimate-only guarantee
+    size_t retired = 0;
+    for (size_t i = 0; i < max_threads_; ++i) {
+        retired += worker_blocks_[i].counters.completed.load(std::memory_order_seq_cst);
+        retired += worker_blocks_[i].counters.disposed.load(std::memory_order_seq_cst);
+    }
+    size_t submitted = 0;
+    for (size_t i = 0; i < max_threads_; ++i) {
+        submitted += worker_blocks_[i].counters.submitted.load(std::memory_order_seq_cst);
+    }
+    return submitted - retired;
 }
 
 void ThreadPool::shutdown_graceful() {
-    if (stop_ || immediate_stop_) {
+    if (immediate_stop_) {
+        // a fail-fast trip or an earlier immediate request forced
+        // immediate mode; that path owns the join and the drain
+        shutdown_immediate();
         return;
     }
-    
+    if (stop_) {
+        return;
+    }
+
     stop_ = true;
-    global_cv_.notify_all();
-    
+    parking_.notify_all();
+    dormant_parking_.notify_all();
+
+    if (controller_.joinable()) {
+        controller_.join();
+    }
+
     for (auto& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
@@ -138,44 +1042,196 @@ void ThreadPool::shutdown_graceful() {
 }
 
 void ThreadPool::shutdown_immediate() {
-    if (immediate_stop_) {
-        return;
+    // no early return on immediate_stop_: a fail-fast trip sets the
+    // flag from a worker and leaves the join and drain to us. joins are
+    // idempotent via joinable() and the drain is guarded below.
+    immediate_stop_ = true;
+    stop_ = true;
+    parking_.notify_all();
+    dormant_parking_.notify_all();
+
+    if (controller_.joinable()) {
+        controller_.join();
+    }
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
     }
     
+    if (drained_.exchange(true)) {
+        return;
+    }
+
+    size_t dropped = lanes_.drain();
+
+    {
+        std::lock_guard<std::mutex> lock(deadline_mutex_);
+        dropped += deadline_heap_.size();
+        deadline_heap_.clear();
+        deadline_count_.store(0, std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < max_threads_; ++i) {
+        Task dummy;
+        while (worker_blocks_[i].queue.pop(dummy)) {
+            dropped++;
+        }
+        while (worker_blocks_[i].low_queue.pop(dummy)) {
+            dropped++;
+        }
+        KeyedLane& lane = worker_blocks_[i].keyed;
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        dropped += lane.tasks.size();
+        lane.tasks.clear();
+        lane.size.store(0, std::memory_order_relaxed);
+    }
+
+    // dropped tasks count as disposed so the pending aggregate drains
+    worker_blocks_[0].counters.disposed.fetch_add(dropped, std::memory_order_seq_cst);
+}
+
+void ThreadPool::drain_to(ThreadPool& other) {
+    if (&other == this) {
+        throw std::invalid_argument("drain_to: cannot drain a pool into itself");
+    }
+
+    // stop exactly like shutdown_immediate: workers quit before their
+    // next pop, so whatever they have not started stays queued for us
     immediate_stop_ = true;
     stop_ = true;
-    global_cv_.notify_all();
-    
+    parking_.notify_all();
+    dormant_parking_.notify_all();
+
+    if (controller_.joinable()) {
+        controller_.join();
+    }
     for (auto& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
         }
     }
-    
+
+    if (drained_.exchange(true)) {
+        return;  // an earlier shutdown already disposed of the backlog
+    }
+
+    size_t moved = 0;
+    Task task;
+
+    // the global lane only ever holds HIGH entries; keep that urgency
+    while (lanes_.pop(task)) {
+        other.enqueue_task(Priority::HIGH, std::move(task));
+        moved++;
+    }
+
+    for (size_t i = 0; i < max_threads_; ++i) {
+        while (worker_blocks_[i].queue.pop(task)) {
+            other.enqueue_task(std::move(task));
+            moved++;
+        }
+        while (worker_blocks_[i].low_queue.pop(task)) {
+            other.enqueue_task(Priority::LOW, std::move(task));
+            moved++;
+        }
+        // keyed entries re-hash onto the receiving pool's home workers
+        // in their original per-key order; enqueue_keyed counts them as
+        // fresh submissions there
+        KeyedLane& lane = worker_blocks_[i].keyed;
+        std::deque<std::pair<uint64_t, Task>> keyed;
+        {
+            std::lock_guard<std::mutex> lock(lane.mutex);
+            keyed.swap(lane.tasks);
+            lane.size.store(0, std::memory_order_relaxed);
+        }
+        for (auto& entry : keyed) {
+            other.enqueue_keyed(entry.first, std::move(entry.second));
+            moved++;
+        }
+    }
+
     {
-        std::lock_guard<std::mutex> lock(global_mutex_);
-        while (!global_queue_.empty()) {
-            global_queue_.pop();
+        std::lock_guard<std::mutex> lock(deadline_mutex_);
+        for (TimerEntry& entry : deadline_heap_) {
+            // add_deadline_task does not count submissions (its caller
+            // does), so the receiving pool's aggregate needs the bump
+            other.worker_blocks_[other.pick_queue()].counters.submitted.fetch_add(
+                1, std::memory_order_seq_cst);
+            other.add_deadline_task(entry.deadline, std::move(entry.task));
+            moved++;
         }
+        deadline_heap_.clear();
+        deadline_count_.store(0, std::memory_order_relaxed);
     }
-    
-    for (auto& queue : local_queues_) {
-        std::function<void()> dummy;
-        while (queue->pop(dummy)) {
+
+    // armed timers were never counted as submitted here, so they move
+    // without any completion credit
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        for (TimerEntry& entry : timers_) {
+            other.add_timer(entry.deadline, std::move(entry.task));
         }
+        timers_.clear();
+        timer_count_.store(0, std::memory_order_relaxed);
+    }
+
+    // moved tasks credit disposed locally so our pending aggregate
+    // drains; the receiving pool counted them as fresh submissions
+    worker_blocks_[0].counters.disposed.fetch_add(moved, std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        wait_cv_.notify_all();
     }
-    
-    pending_tasks_ = 0;
 }
 
 size_t ThreadPool::num_threads() const {
     return workers_.size();
 }
 
+size_t ThreadPool::active_threads() const {
+    return active_target_.load(std::memory_order_relaxed);
+}
+
+size_t ThreadPool::num_nodes() const {
+    return node_workers_.size();
+}
+
 ThreadPool::Stats ThreadPool::get_stats() const {
-    return Stats{
-        tasks_completed_.load(),
-        tasks_stolen_.load(),
-        total_tasks_submitted_.load()
-    };
+    Stats stats{};
+    for (size_t i = 0; i < max_threads_; ++i) {
+        const CounterShard& counters = worker_blocks_[i].counters;
+        stats.tasks_completed += counters.completed.load(std::memory_order_seq_cst);
+        stats.tasks_stolen += counters.stolen.load(std::memory_order_seq_cst);
+        stats.total_tasks_submitted += counters.submitted.load(std::memory_order_seq_cst);
+        stats.steal_batches += counters.steal_batches.load(std::memory_order_seq_cst);
+        stats.tasks_shed += counters.shed.load(std::memory_order_seq_cst);
+        stats.tasks_dropped += counters.dropped.load(std::memory_order_seq_cst);
+    }
+    stats.peak_pending = peak_pending_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+ThreadPool::DetailedStats ThreadPool::get_detailed_stats() const {
+    DetailedStats stats;
+    stats.workers.resize(max_threads_);
+    for (size_t i = 0; i < max_threads_; ++i) {
+        WorkerStats& worker = stats.workers[i];
+        worker.wait_hist.assign(HIST_BUCKETS, 0);
+        worker.run_hist.assign(HIST_BUCKETS, 0);
+        worker.steal_attempts = 0;
+        worker.steal_successes = 0;
+        worker.queue_depth = worker_blocks_[i].queue.size() +
+                             worker_blocks_[i].low_queue.size() +
+                             worker_blocks_[i].keyed.size.load(std::memory_order_relaxed);
+        if (metrics_) {
+            for (size_t b = 0; b < HIST_BUCKETS; ++b) {
+                worker.wait_hist[b] = metrics_[i].wait_hist[b].load(std::memory_order_relaxed);
+                worker.run_hist[b] = metrics_[i].run_hist[b].load(std::memory_order_relaxed);
+            }
+            worker.steal_attempts = metrics_[i].steal_attempts.load(std::memory_order_relaxed);
+            worker.steal_successes = metrics_[i].steal_successes.load(std::memory_order_relaxed);
+        }
+    }
+    return stats;
 }
@@ -2,7 +2,6 @@
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
 #include <deque>
 #include <memory>
 #include <thread>
@@ -13,6 +12,18 @@
 #include <stdexcept>
 #include <atomic>
 #include <random>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <map>
+
+// coroutine surface is compiled in when the toolchain speaks C++20
+// coroutines; everything else works without it
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define THREAD_POOL_HAS_COROUTINES 1
+#endif
 
 // task prio levels
 enum class Priority {
@@ -23,171 +34,2271 @@ enum class Priority {
 
 class ThreadPool;
 
+// move-only callable wrapper with a large inline buffer
+// std::function heap-allocates as soon as a capture outgrows its tiny SBO
+// (a lambda capturing this + a shared_ptr already does on libstdc++), which
+// costs a malloc per task on the submit path. Task keeps anything up to
+// STORAGE_SIZE bytes inline and only spills bigger captures to the heap.
+// being move-only it can also hold move-only callables like a lambda that
+// captured a std::packaged_task, so submit no longer needs the
+// shared_ptr<packaged_task> indirection.
+class Task {
+private:
+    static constexpr size_t STORAGE_SIZE = 128;
+
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*relocate)(void* from, void* to);
+        void (*destroy)(void* storage);
+    };
+
+    template<class F>
+    struct InlineOps {
+        static void invoke(void* storage) {
+            (*static_cast<F*>(storage))();
+        }
+        static void relocate(void* from, void* to) {
+            new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        static void destroy(void* storage) {
+            static_cast<F*>(storage)->~F();
+        }
+        static constexpr Ops ops = {&invoke, &relocate, &destroy};
+    };
+
+    // fallback for captures too big for the inline buffer
+    template<class F>
+    struct HeapOps {
+        static F* get(void* storage) {
+            return *static_cast<F**>(storage);
+        }
+        static void invoke(void* storage) {
+            (*get(storage))();
+        }
+        static void relocate(void* from, void* to) {
+            *static_cast<F**>(to) = get(from);
+        }
+        static void destroy(void* storage) {
+            delete get(storage);
+        }
+        static constexpr Ops ops = {&invoke, &relocate, &destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[STORAGE_SIZE];
+    const Ops* ops_;
+
+public:
+    Task() : ops_(nullptr) {}
+
+    template<class F,
+             class D = typename std::decay<F>::type,
+             class = typename std::enable_if<!std::is_same<D, Task>::value>::type>
+    Task(F&& f) {
+        if constexpr (sizeof(D) <= STORAGE_SIZE && alignof(D) <= alignof(std::max_align_t)) {
+            new (storage_) D(std::forward<F>(f));
+            ops_ = &InlineOps<D>::ops;
+        } else {
+            *reinterpret_cast<D**>(storage_) = new D(std::forward<F>(f));
+            ops_ = &HeapOps<D>::ops;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->relocate(other.storage_, storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (ops_) {
+                ops_->destroy(storage_);
+            }
+            ops_ = other.ops_;
+            if (ops_) {
+                ops_->relocate(other.storage_, storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (ops_) {
+            ops_->destroy(storage_);
+        }
+    }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    explicit operator bool() const {
+        return ops_ != nullptr;
+    }
+};
+
+// per-thread slab allocator for the Task nodes the queues traffic in.
+// every enqueued task used to be a malloc on submit and a free on the
+// executing worker, fragmenting the heap and contending the allocator's
+// central freelists across workers. nodes now come from cache-line
+// aligned slabs owned by the allocating thread: allocation is a pointer
+// pop off a thread-local freelist, a same-thread free is a pointer
+// push, and a free from a stealing thread goes onto the owner's
+// lock-free remote list, reclaimed in bulk the next time the owner
+// allocates. arenas of exited threads are parked in a global cache and
+// handed to future threads, never destroyed, so a late remote free can
+// always reach its owner.
+class TaskArena {
+private:
+    struct alignas(64) Node {
+        TaskArena* owner;
+        Node* next;
+        alignas(std::max_align_t) unsigned char storage[sizeof(Task)];
+    };
+
+    static constexpr size_t SLAB_NODES = 64;
+
+    Node* free_list_ = nullptr;
+    std::atomic<Node*> remote_free_{nullptr};
+    std::vector<std::unique_ptr<Node[]>> slabs_;
+
+    static std::mutex cache_mutex_;
+    static std::vector<TaskArena*> cache_;
+
+    static TaskArena* obtain() {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (!cache_.empty()) {
+            TaskArena* arena = cache_.back();
+            cache_.pop_back();
+            return arena;
+        }
+        return new TaskArena();
+    }
+
+    static void retire(TaskArena* arena) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        cache_.push_back(arena);
+    }
+
+    // ties the arena to the thread's lifetime without ever deleting it
+    struct Holder {
+        TaskArena* arena;
+        Holder() : arena(obtain()) {}
+        ~Holder() { retire(arena); }
+    };
+
+    void new_slab() {
+        // allocated as Node[] so the array new honours alignas(64); a
+        // raw byte slab only guarantees max_align_t alignment, and
+        // placement-new of an over-aligned type into that is UB
+        auto slab = std::make_unique<Node[]>(SLAB_NODES);
+        for (size_t i = 0; i < SLAB_NODES; ++i) {
+            Node* node = &slab[i];
+            node->owner = this;
+            node->next = free_list_;
+            free_list_ = node;
+        }
+        slabs_.push_back(std::move(slab));
+    }
+
+    static Node* from_storage(void* storage) {
+        return reinterpret_cast<Node*>(
+            static_cast<unsigned char*>(storage) - offsetof(Node, storage));
+    }
+
+public:
+    static TaskArena& local() {
+        static thread_local Holder holder;
+        return *holder.arena;
+    }
+
+    // owner thread only (it is the thread-local arena)
+    void* allocate() {
+        if (!free_list_) {
+            // reclaim everything stealing threads handed back, in bulk
+            free_list_ = remote_free_.exchange(nullptr, std::memory_order_acquire);
+        }
+        if (!free_list_) {
+            new_slab();
+        }
+        Node* node = free_list_;
+        free_list_ = node->next;
+        return node->storage;
+    }
+
+    // safe from any thread
+    static void release(void* storage) {
+        Node* node = from_storage(storage);
+        TaskArena* owner = node->owner;
+        if (&local() == owner) {
+            node->next = owner->free_list_;
+            owner->free_list_ = node;
+            return;
+        }
+        // deferred remote free: push onto the owner's lock-free list
+        Node* head = owner->remote_free_.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!owner->remote_free_.compare_exchange_weak(
+            head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+};
+
+// lock-free Chase-Lev work-stealing deque
+// the owner worker pushes and pops at the bottom (LIFO, hot cache) and
+// thieves take from the top (FIFO), coordinated only through atomic
+// top_/bottom_ indices -- no lock on the pop/steal hot path.
+//
+// Chase-Lev requires a single producer, so pushes from threads other than
+// the owner go through a small mutex-guarded inbox that the owner drains
+// into the deque when its local work runs out. thieves never touch that
+// mutex, which is what used to serialize everything.
 class WorkStealingQueue {
 private:
-    std::deque<std::function<void()>> queue_;
-    mutable std::mutex mutex_;
+    using TaskPtr = Task*;
+
+    // growable circular buffer; old generations are kept alive until the
+    // queue dies because a thief may still be reading a stale pointer
+    struct RingBuffer {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<TaskPtr>[]> slots;
+
+        explicit RingBuffer(int64_t cap)
+            : capacity(cap)
+            , mask(cap - 1)
+            , slots(new std::atomic<TaskPtr>[cap]) {}
+
+        TaskPtr get(int64_t index) const {
+            return slots[index & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t index, TaskPtr task) {
+            slots[index & mask].store(task, std::memory_order_relaxed);
+        }
+    };
+
+    static constexpr int64_t INITIAL_CAPACITY = 256;
+
+    std::atomic<int64_t> top_;
+    std::atomic<int64_t> bottom_;
+    std::atomic<RingBuffer*> buffer_;
+    std::vector<std::unique_ptr<RingBuffer>> generations_;
+
+    std::deque<TaskPtr> inbox_;
+    mutable std::mutex inbox_mutex_;
+    std::atomic<size_t> inbox_size_;
+
+    // task nodes live in the submitting thread's arena; frees from
+    // whichever thread ran the task route back there
+    static TaskPtr make_node(Task&& task) {
+        return new (TaskArena::local().allocate()) Task(std::move(task));
+    }
+
+    static void destroy_node(TaskPtr node) {
+        node->~Task();
+        TaskArena::release(node);
+    }
+
+    void owner_push(TaskPtr task) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        RingBuffer* buf = buffer_.load(std::memory_order_relaxed);
+
+        if (b - t > buf->capacity - 1) {
+            buf = grow(buf, t, b);
+        }
+
+        buf->put(b, task);
+#if defined(__SANITIZE_THREAD__)
+        // tsan does not model thread fences, so the fence-based
+        // publication reports false races on the task objects; under
+        // tsan the ordering moves onto the atomics themselves
+        bottom_.store(b + 1, std::memory_order_seq_cst);
+#else
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+#endif
+    }
+
+    TaskPtr owner_pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        RingBuffer* buf = buffer_.load(std::memory_order_relaxed);
+#if defined(__SANITIZE_THREAD__)
+        bottom_.exchange(b, std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_seq_cst);
+#else
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+#endif
+
+        if (t <= b) {
+            TaskPtr task = buf->get(b);
+            if (t == b) {
+                // last element, settle the race with thieves on top_
+                if (!top_.compare_exchange_strong(t, t + 1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    task = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return task;
+        }
+
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    TaskPtr steal_top() {
+#if defined(__SANITIZE_THREAD__)
+        int64_t t = top_.load(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_seq_cst);
+#else
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+#endif
+
+        if (t < b) {
+            RingBuffer* buf = buffer_.load(std::memory_order_acquire);
+            TaskPtr task = buf->get(t);
+            if (!top_.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return task;
+        }
+
+        return nullptr;
+    }
+
+    RingBuffer* grow(RingBuffer* old, int64_t t, int64_t b) {
+        auto bigger = std::make_unique<RingBuffer>(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        RingBuffer* raw = bigger.get();
+        generations_.push_back(std::move(bigger));
+        buffer_.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+    void drain_inbox() {
+        std::deque<TaskPtr> grabbed;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            grabbed.swap(inbox_);
+        }
+        if (grabbed.empty()) {
+            return;
+        }
+        inbox_size_.fetch_sub(grabbed.size(), std::memory_order_relaxed);
+        for (TaskPtr task : grabbed) {
+            owner_push(task);
+        }
+    }
 
 public:
-    WorkStealingQueue() = default;
-    
-    void push(std::function<void()> task) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push_front(std::move(task));
+    WorkStealingQueue()
+        : top_(0)
+        , bottom_(0)
+        , inbox_size_(0) {
+        generations_.push_back(std::make_unique<RingBuffer>(INITIAL_CAPACITY));
+        buffer_.store(generations_.back().get(), std::memory_order_relaxed);
     }
-    
-    bool pop(std::function<void()>& task) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) {
+
+    ~WorkStealingQueue() {
+        // by now no workers touch the queue, safe to act as the owner
+        Task dummy;
+        while (pop(dummy)) {
+        }
+    }
+
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+    // safe from any thread
+    void push(Task task) {
+        TaskPtr node = make_node(std::move(task));
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            inbox_.push_back(node);
+        }
+        inbox_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // safe from any thread; the whole chunk goes in under one lock
+    void push_bulk(std::vector<Task> tasks) {
+        if (tasks.empty()) {
+            return;
+        }
+        std::vector<TaskPtr> nodes;
+        nodes.reserve(tasks.size());
+        for (Task& task : tasks) {
+            nodes.push_back(make_node(std::move(task)));
+        }
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            inbox_.insert(inbox_.end(), nodes.begin(), nodes.end());
+        }
+        inbox_size_.fetch_add(nodes.size(), std::memory_order_relaxed);
+    }
+
+    // owner thread only: straight into the deque bottom, no inbox, no
+    // lock -- the fast path for tasks spawned by the worker itself
+    void push_local(Task task) {
+        owner_push(make_node(std::move(task)));
+    }
+
+    // admission control: remove the oldest queued task. safe from any
+    // thread. the inbox front is checked first (strict arrival order
+    // for external pushes), then the deque top via a one-task steal.
+    bool try_evict(Task& out) {
+        TaskPtr node = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            if (!inbox_.empty()) {
+                node = inbox_.front();
+                inbox_.pop_front();
+            }
+        }
+        if (node) {
+            inbox_size_.fetch_sub(1, std::memory_order_relaxed);
+            out = std::move(*node);
+            destroy_node(node);
+            return true;
+        }
+        node = steal_top();
+        if (node) {
+            out = std::move(*node);
+            destroy_node(node);
+            return true;
+        }
+        return false;
+    }
+
+    // owner thread only
+    bool pop(Task& task) {
+        TaskPtr node = owner_pop();
+        if (!node) {
+            drain_inbox();
+            node = owner_pop();
+        }
+        if (!node) {
             return false;
         }
-        task = std::move(queue_.front());
-        queue_.pop_front();
+        task = std::move(*node);
+        destroy_node(node);
         return true;
     }
-    
-    bool steal(std::function<void()>& task) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) {
-            return false;
+
+    // thief-side batch steal: claims up to max_n tasks, capped at half
+    // the victim's visible backlog, appending them to out. the claims
+    // stay one CAS per slot -- a single top_ += n CAS races the owner's
+    // bottom-side pops in Chase-Lev -- but the thief skips the victim
+    // re-scan and wakeup traffic it used to pay per task. when the deque
+    // is dry, half the inbox moves over under one lock instead.
+    size_t steal_batch(std::vector<Task>& out, size_t max_n) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        int64_t avail = b - t;
+
+        size_t want = 0;
+        if (avail > 0) {
+            want = std::min(max_n, static_cast<size_t>((avail + 1) / 2));
+        }
+
+        size_t got = 0;
+        while (got < want) {
+            TaskPtr node = steal_top();
+            if (!node) {
+                break;
+            }
+            out.push_back(std::move(*node));
+            destroy_node(node);
+            got++;
+        }
+        if (got > 0) {
+            return got;
+        }
+
+        std::deque<TaskPtr> grabbed;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            size_t take = std::min(max_n, (inbox_.size() + 1) / 2);
+            while (grabbed.size() < take) {
+                grabbed.push_back(inbox_.front());
+                inbox_.pop_front();
+            }
+        }
+        if (!grabbed.empty()) {
+            inbox_size_.fetch_sub(grabbed.size(), std::memory_order_relaxed);
+            for (TaskPtr node : grabbed) {
+                out.push_back(std::move(*node));
+                destroy_node(node);
+                got++;
+            }
+        }
+        return got;
+    }
+
+    // safe from any thread; falls back to the inbox so work is not stuck
+    // behind an owner that is busy in a long task
+    bool steal(Task& task) {
+        TaskPtr node = steal_top();
+        if (!node) {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            if (inbox_.empty()) {
+                return false;
+            }
+            node = inbox_.front();
+            inbox_.pop_front();
+            inbox_size_.fetch_sub(1, std::memory_order_relaxed);
         }
-        task = std::move(queue_.back());
-        queue_.pop_back();
+        task = std::move(*node);
+        destroy_node(node);
         return true;
     }
-    
+
     size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        int64_t deque_size = (b > t) ? (b - t) : 0;
+        return static_cast<size_t>(deque_size) + inbox_size_.load(std::memory_order_relaxed);
     }
-    
+
     bool empty() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.empty();
+        return size() == 0;
     }
 };
 
-class ThreadPool {
-public:
-    explicit ThreadPool(size_t num_threads);
-    
-    ~ThreadPool();
-    
-    template<class F, class... Args>
-    auto submit(F&& f, Args&&... args) 
-        -> std::future<typename std::invoke_result<F, Args...>::type>;
-    
-    template<class F, class... Args>
-    auto submit(Priority priority, F&& f, Args&&... args) 
-        -> std::future<typename std::invoke_result<F, Args...>::type>;
-    
-    void wait_all();
-    
-    size_t active_tasks() const;
-    
-    size_t pending_tasks() const;
-    
-    void shutdown_graceful();
-    
-    void shutdown_immediate();
-    
-    size_t num_threads() const;
-    
-    struct Stats {
-        size_t tasks_completed;
-        size_t tasks_stolen;
-        size_t total_tasks_submitted;
+// three fixed-priority MPMC lanes replacing the old mutex-guarded
+// std::priority_queue. each lane is a bounded ring in the Vyukov style:
+// every slot carries a sequence number that says whose turn it is, so
+// push and pop are a CAS plus two loads with no lock anywhere. a burst
+// past the ring capacity spills into a mutex-guarded overflow list, but
+// workers check an atomic count before touching that mutex, so the rare
+// spill never taxes the common case. emptiness is a couple of relaxed
+// loads -- that is all get_task pays when nobody uses priorities.
+class PriorityLanes {
+private:
+    static constexpr size_t LANE_CAPACITY = 1024;  // power of two
+    static constexpr size_t LANE_MASK = LANE_CAPACITY - 1;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Task task;
     };
-    
-    Stats get_stats() const;
 
-private:
-    void worker_thread(size_t thread_id);
-    
-    bool get_task(size_t thread_id, std::function<void()>& task);
-    
-    bool try_steal(size_t thread_id, std::function<void()>& task);
-    
-    struct PriorityTask {
-        Priority priority;
-        std::function<void()> task;
-        
-        bool operator<(const PriorityTask& other) const {
-            return priority > other.priority;
+    struct Lane {
+        std::unique_ptr<Cell[]> cells;
+        alignas(64) std::atomic<size_t> enqueue_pos;
+        alignas(64) std::atomic<size_t> dequeue_pos;
+        std::mutex overflow_mutex;
+        std::deque<Task> overflow;
+        std::atomic<size_t> overflow_size;
+
+        Lane()
+            : cells(new Cell[LANE_CAPACITY])
+            , enqueue_pos(0)
+            , dequeue_pos(0)
+            , overflow_size(0) {
+            for (size_t i = 0; i < LANE_CAPACITY; ++i) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
         }
     };
-    
-    std::vector<std::thread> workers_;
-    std::vector<std::unique_ptr<WorkStealingQueue>> local_queues_;
-    
-    std::priority_queue<PriorityTask> global_queue_;
-    std::mutex global_mutex_;
-    std::condition_variable global_cv_;
-    
-    std::atomic<bool> stop_;
-    std::atomic<bool> immediate_stop_;
-    std::atomic<size_t> active_tasks_;
-    std::atomic<size_t> pending_tasks_;
-    
-    std::atomic<size_t> tasks_completed_;
-    std::atomic<size_t> tasks_stolen_;
-    std::atomic<size_t> total_tasks_submitted_;
-    
-    std::random_device rd_;
-    std::mt19937 gen_;
-    
-    std::condition_variable wait_cv_;
-    std::mutex wait_mutex_;
-};
 
-template<class F, class... Args>
-auto ThreadPool::submit(F&& f, Args&&... args) 
-    -> std::future<typename std::invoke_result<F, Args...>::type> {
-    return submit(Priority::MEDIUM, std::forward<F>(f), std::forward<Args>(args)...);
-}
+    Lane lanes_[3];
 
-template<class F, class... Args>
-auto ThreadPool::submit(Priority priority, F&& f, Args&&... args) 
-    -> std::future<typename std::invoke_result<F, Args...>::type> {
-    
-    using return_type = typename std::invoke_result<F, Args...>::type;
-    
-    if (stop_ || immediate_stop_) {
-        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    static bool ring_push(Lane& lane, Task& task) {
+        size_t pos = lane.enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = lane.cells[pos & LANE_MASK];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (lane.enqueue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.task = std::move(task);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full, caller spills to overflow
+            } else {
+                pos = lane.enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
     }
-    
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-    );
-    
-    std::future<return_type> result = task->get_future();
-    
-    auto wrapped_task = [this, task]() {
-        try {
-            (*task)();
-        } catch (...) {
+
+    static bool ring_pop(Lane& lane, Task& task) {
+        size_t pos = lane.dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = lane.cells[pos & LANE_MASK];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (lane.dequeue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    task = std::move(cell.task);
+                    cell.sequence.store(pos + LANE_CAPACITY, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = lane.dequeue_pos.load(std::memory_order_relaxed);
+            }
         }
-        active_tasks_--;
-        pending_tasks_--;
-        tasks_completed_++;
-        wait_cv_.notify_all();
-    };
-    
-    active_tasks_++;
-    pending_tasks_++;
-    total_tasks_submitted_++;
-    
-    if (priority == Priority::HIGH) {
-        std::lock_guard<std::mutex> lock(global_mutex_);
-        global_queue_.push({priority, std::move(wrapped_task)});
-        global_cv_.notify_one();
-    } else {
-        static std::atomic<size_t> counter{0};
-        size_t thread_id = counter++ % workers_.size();
-        local_queues_[thread_id]->push(std::move(wrapped_task));
-        global_cv_.notify_one();
     }
-    
+
+    static bool lane_empty(const Lane& lane) {
+        return lane.enqueue_pos.load(std::memory_order_relaxed) ==
+                   lane.dequeue_pos.load(std::memory_order_relaxed) &&
+               lane.overflow_size.load(std::memory_order_relaxed) == 0;
+    }
+
+public:
+    PriorityLanes() = default;
+
+    PriorityLanes(const PriorityLanes&) = delete;
+    PriorityLanes& operator=(const PriorityLanes&) = delete;
+
+    void push(Priority priority, Task task) {
+        Lane& lane = lanes_[static_cast<size_t>(priority)];
+        // once something spilled, later pushes follow it into the
+        // overflow so the lane stays roughly FIFO
+        if (lane.overflow_size.load(std::memory_order_relaxed) == 0 &&
+            ring_push(lane, task)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(lane.overflow_mutex);
+            lane.overflow.push_back(std::move(task));
+        }
+        lane.overflow_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // scans HIGH to LOW; higher lanes always drain first
+    bool pop(Task& task) {
+        for (Lane& lane : lanes_) {
+            if (lane_empty(lane)) {
+                continue;
+            }
+            if (ring_pop(lane, task)) {
+                return true;
+            }
+            if (lane.overflow_size.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(lane.overflow_mutex);
+                if (!lane.overflow.empty()) {
+                    task = std::move(lane.overflow.front());
+                    lane.overflow.pop_front();
+                    lane.overflow_size.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // approximate, like the queue size checks elsewhere
+    bool empty() const {
+        for (const Lane& lane : lanes_) {
+            if (!lane_empty(lane)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // shutdown only: discard everything, report how many
+    size_t drain() {
+        size_t dropped = 0;
+        Task dummy;
+        while (pop(dummy)) {
+            dropped++;
+        }
+        return dropped;
+    }
+};
+
+// event count for worker parking
+// idle workers park here indefinitely instead of polling a 10ms timed
+// wait. the epoch ticket closes the classic check-then-sleep race: a
+// waiter grabs a ticket, re-checks for work, and only sleeps if the
+// epoch has not moved. producers that find no waiters pay a single
+// atomic load and skip the cv entirely.
+class EventCount {
+private:
+    std::atomic<uint64_t> epoch_;
+    std::atomic<int> waiters_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+public:
+    EventCount() : epoch_(0), waiters_(0) {}
+
+    // step 1: announce intent to sleep, then re-check for work
+    uint64_t prepare_wait() {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    // step 2a: work showed up during the re-check, never mind
+    void cancel_wait() {
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // step 2c: like wait, but give up once the deadline passes so the
+    // sleeper can go service whatever was due
+    void wait_until(uint64_t ticket, std::chrono::steady_clock::time_point deadline) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_until(lock, deadline, [this, ticket] {
+                return epoch_.load(std::memory_order_seq_cst) != ticket;
+            });
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // step 2b: sleep until the epoch moves past our ticket
+    void wait(uint64_t ticket) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this, ticket] {
+                return epoch_.load(std::memory_order_seq_cst) != ticket;
+            });
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void notify_one() {
+        // full fence before the bail-out load: the producer's queue
+        // writes may be relaxed stores, and without the fence the load
+        // below can be satisfied early -- reading waiters_ == 0 from
+        // before a consumer announced itself and re-checked, stranding
+        // the task. x86 happens to order this anyway; ARM does not.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+
+    void notify_all() {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_all();
+    }
+};
+
+template<class T>
+class TaskFuture;
+
+// handoff cell between a chained task and its TaskFuture: whoever gets
+// here second (the completing worker or a then() call) is responsible
+// for enqueueing the continuation, so nobody ever blocks on it
+struct TaskChainState {
+    std::mutex mutex;
+    bool completed = false;
+    Task continuation;
+    ThreadPool* pool = nullptr;
+};
+
+// future wrapper returned by ThreadPool::async; behaves like a
+// std::future plus then() for non-blocking continuation chaining.
+// then() consumes the future -- read the result from the TaskFuture it
+// returns instead.
+template<class T>
+class TaskFuture {
+public:
+    TaskFuture() = default;
+
+    T get() {
+        return future_.get();
+    }
+
+    void wait() {
+        future_.wait();
+    }
+
+    bool valid() const {
+        return future_.valid();
+    }
+
+    template<class G>
+    using then_result_t = typename std::conditional<
+        std::is_void<T>::value,
+        std::invoke_result<G>,
+        std::invoke_result<G, T>>::type::type;
+
+    // schedule g to run with this task's result once it is ready; the
+    // continuation is enqueued by the completing worker, never waited on
+    template<class G>
+    auto then(G&& g) -> TaskFuture<then_result_t<G>>;
+
+private:
+    friend class ThreadPool;
+
+    TaskFuture(std::future<T> future, std::shared_ptr<TaskChainState> state, ThreadPool* pool)
+        : future_(std::move(future))
+        , state_(std::move(state))
+        , pool_(pool) {}
+
+    std::future<T> future_;
+    std::shared_ptr<TaskChainState> state_;
+    ThreadPool* pool_ = nullptr;
+};
+
+#ifdef THREAD_POOL_HAS_COROUTINES
+
+// shared promise machinery for CoTask below. a finished coroutine
+// either hands control straight to its awaiter (symmetric transfer) or,
+// for a top-level task nobody co_awaits, flips a flag for a blocking
+// get()
+struct CoTaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            CoTaskPromiseBase& promise = handle.promise();
+            if (promise.continuation) {
+                return promise.continuation;
+            }
+            // notify under the lock so a woken get() cannot destroy the
+            // frame while we are still touching the cv
+            {
+                std::lock_guard<std::mutex> lock(promise.mutex);
+                promise.done = true;
+                promise.cv.notify_all();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() {
+        error = std::current_exception();
+    }
+};
+
+template<class T>
+struct CoTaskPromise : CoTaskPromiseBase {
+    T value{};
+
+    void return_value(T v) {
+        value = std::move(v);
+    }
+};
+
+template<>
+struct CoTaskPromise<void> : CoTaskPromiseBase {
+    void return_void() {}
+};
+
+// coroutine return type (CoTask because Task already names the
+// type-erased callable above). lazy: the body only runs once the task
+// is awaited or get() is called. a coroutine that starts with
+// co_await pool.schedule() hops onto a worker and from there on a
+// suspended chain costs coroutine frames, not blocked threads.
+template<class T = void>
+class CoTask {
+public:
+    struct promise_type : CoTaskPromise<T> {
+        CoTask get_return_object() {
+            return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    CoTask() = default;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle)
+        : handle_(handle) {}
+
+    CoTask(CoTask&& other) noexcept : handle_(other.handle_) {
+        other.handle_ = {};
+    }
+
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = other.handle_;
+            other.handle_ = {};
+        }
+        return *this;
+    }
+
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    // co_await support: starts the child inline; the child resumes the
+    // awaiter via symmetric transfer from its final suspend point
+    bool await_ready() const noexcept {
+        return !handle_ || handle_.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume() {
+        auto& promise = handle_.promise();
+        if (promise.error) {
+            std::rethrow_exception(promise.error);
+        }
+        if constexpr (!std::is_void<T>::value) {
+            return std::move(promise.value);
+        }
+    }
+
+    // blocking bridge for plain callers; only valid on a task nobody
+    // co_awaits
+    T get() {
+        auto& promise = handle_.promise();
+        handle_.resume();
+        {
+            std::unique_lock<std::mutex> lock(promise.mutex);
+            promise.cv.wait(lock, [&promise] { return promise.done; });
+        }
+        return await_resume();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+#endif  // THREAD_POOL_HAS_COROUTINES
+
+class ThreadPool {
+public:
+    // what happens to a submission that finds the pool at max_pending
+    enum class OverflowPolicy {
+        BLOCK,        // wait until a completion frees room
+        REJECT,       // throw; the producer handles the shed
+        DROP_OLDEST,  // evict the oldest queued task, then enqueue
+        CALLER_RUNS   // run inline on the submitting thread
+    };
+
+    // worker placement options; pinning is Linux-only and silently a
+    // no-op elsewhere
+    struct Options {
+        // pin worker i to cpu_ids[i % cpu_ids.size()], or to core
+        // i % hardware_concurrency when cpu_ids is empty
+        bool pin_threads = false;
+        std::vector<int> cpu_ids;
+        // number of NUMA nodes to spread workers over; 0 means detect
+        // from the pinned cpus' package ids (or treat as one node)
+        size_t numa_nodes = 0;
+        // elastic sizing: keep between min_threads and max_threads
+        // workers active, scaling on sustained backlog. 0 means "use the
+        // constructor's thread count", so the default pool stays fixed.
+        // threads are created up to max_threads once and cached: a
+        // retired worker parks on an event count and re-attaches with a
+        // notify instead of paying std::thread creation at every ramp.
+        size_t min_threads = 0;
+        size_t max_threads = 0;
+        // opt-in hot-path instrumentation: per-worker latency/run-time
+        // histograms and steal counters behind get_detailed_stats().
+        // off (the default) costs one null check per enqueue.
+        bool enable_instrumentation = false;
+        // anti-starvation ratio for the per-worker LOW lane: a worker
+        // drains at most this many MEDIUM tasks in a row before taking
+        // one LOW task, so batch backfill still trickles through under
+        // saturation. 0 means strict: LOW only runs when MEDIUM is dry.
+        size_t low_ratio = 8;
+        // fail fast: an exception reaching the pool's handler path (the
+        // futureless post/timer/pipeline family) also trips the pool
+        // into immediate shutdown after the handler runs, so a throwing
+        // task surfaces as rejected submits instead of corrupt output
+        // hours later. queued work is dropped as in shutdown_immediate.
+        bool fail_fast = false;
+        // lazy spawn: workers (and the elastic controller) start on the
+        // first submit instead of in the constructor, so a short-lived
+        // tool that builds a pool it may never use pays nothing up
+        // front. costs one relaxed load per enqueue once spawned.
+        bool lazy_spawn = false;
+        // admission control: cap on pending (queued or running) tasks;
+        // 0 = unbounded, the historical behaviour. at the cap,
+        // overflow_policy decides the submitter's fate. pool workers
+        // subdividing their own work are never throttled -- blocking a
+        // worker on its own backlog is a deadlock. the cap is one
+        // pool-wide aggregate, not per queue: stealing rebalances
+        // queues continuously, so a per-queue number would throttle on
+        // placement luck rather than real backlog. every external
+        // entry point is admitted -- submit/post, bulk, keyed,
+        // deadline -- except the timer family: an armed timer is a
+        // schedule, not backlog, and what it enqueues when it fires
+        // goes through admission like any other task.
+        size_t max_pending = 0;
+        OverflowPolicy overflow_policy = OverflowPolicy::BLOCK;
+    };
+
+    explicit ThreadPool(size_t num_threads);
+
+    ThreadPool(size_t num_threads, const Options& options);
+
+    ~ThreadPool();
+    
+    template<class F, class... Args>
+    auto submit(F&& f, Args&&... args) 
+        -> std::future<typename std::invoke_result<F, Args...>::type>;
+    
+    template<class F, class... Args>
+    auto submit(Priority priority, F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+    // batch submission: one counter bump, one inbox lock per queue chunk
+    // and only as many wakeups as the batch can keep busy
+    template<class Iterator>
+    auto submit_bulk(Iterator first, Iterator last)
+        -> std::vector<std::future<typename std::invoke_result<
+               typename std::iterator_traits<Iterator>::value_type>::type>>;
+
+    template<class Iterator>
+    auto submit_bulk(Priority priority, Iterator first, Iterator last)
+        -> std::vector<std::future<typename std::invoke_result<
+               typename std::iterator_traits<Iterator>::value_type>::type>>;
+
+    // like submit but returns a TaskFuture supporting then(); costs one
+    // extra small allocation for the chain state, which is why plain
+    // submit does not pay for it
+    template<class F, class... Args>
+    auto async(F&& f, Args&&... args)
+        -> TaskFuture<typename std::invoke_result<F, Args...>::type>;
+
+    // fire-and-forget submission: no packaged_task, no future, no shared
+    // state, just the callable into a queue. exceptions escaping the
+    // callable are routed to the handler set via set_exception_handler
+    // instead of being swallowed; without a handler they are dropped.
+    template<class F>
+    void post(F&& f);
+
+    template<class F>
+    void post(Priority priority, F&& f);
+
+    void set_exception_handler(std::function<void(std::exception_ptr)> handler);
+
+    // deferred scheduling, serviced by the workers themselves: an idle
+    // worker parks exactly until the nearest deadline and a due timer
+    // fires into that worker's own local queue -- no separate timer
+    // thread, no cross-thread handoff. fire-and-forget like post;
+    // timers that have not fired by shutdown are dropped.
+    template<class Rep, class Period, class F>
+    void submit_after(std::chrono::duration<Rep, Period> delay, F&& f);
+
+    template<class Clock, class Duration, class F>
+    void submit_at(std::chrono::time_point<Clock, Duration> when, F&& f);
+
+    // fires every interval until shutdown; the next firing is armed from
+    // the previous deadline, so the cadence does not drift under load
+    template<class Rep, class Period, class F>
+    void submit_periodic(std::chrono::duration<Rep, Period> interval, F&& f);
+
+    // locality-keyed submission: equal keys hash to a stable home
+    // worker and run there in submission order, keeping per-key state
+    // (a connection's parser, a shard's aggregate) in one cache. keyed
+    // tasks are stolen only as a last resort, one key at a time, and a
+    // key never runs on two threads at once -- so ordering survives the
+    // migration. pairs best with fixed-size pools: elastic retirement
+    // leaves a dormant home queue to be drained by thieves.
+    template<class F, class... Args>
+    auto submit_with_key(uint64_t key, F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+    // earliest-deadline-first lane: the task outranks every static
+    // priority bucket except HIGH and tighter deadlines run first. a
+    // task still queued past its deadline is shed without executing --
+    // its future reports broken_promise and Stats::tasks_shed counts it
+    template<class F, class... Args>
+    auto submit_with_deadline(std::chrono::steady_clock::time_point deadline,
+                              F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+#ifdef THREAD_POOL_HAS_COROUTINES
+    // co_await pool.schedule() hops the calling coroutine onto a worker;
+    // the resume travels through the normal queue path at the requested
+    // priority, so it parks, steals and accounts like any other task
+    struct ScheduleAwaiter {
+        ThreadPool* pool;
+        Priority priority;
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            pool->enqueue_task(priority, Task([handle]() { handle.resume(); }));
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    ScheduleAwaiter schedule(Priority priority = Priority::MEDIUM) {
+        if (stop_ || immediate_stop_) {
+            throw std::runtime_error("Cannot submit task to stopped thread pools");
+        }
+        return {this, priority};
+    }
+#endif
+
+    // route a task to a worker on the given NUMA node so it runs near
+    // its data; round-robins within the node's workers
+    template<class F, class... Args>
+    auto submit_to_node(size_t node, F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+    size_t num_nodes() const;
+
+    // dynamic load-balanced loops: the range is submitted as a single
+    // task that splits itself in half down to a grain, pushing the right
+    // halves into the worker's own queue where idle threads steal them.
+    // that gives TBB-style balancing on skewed loads without one future
+    // per chunk. blocks the caller until the whole range is done, so
+    // call it from outside the pool.
+    template<class Index, class Body>
+    void parallel_for(Index begin, Index end, Body body);
+
+    // body is (Index begin, Index end, T init) -> T over a subrange;
+    // reduce combines two partials. identity must be neutral for reduce.
+    template<class Index, class T, class Body, class Reduce>
+    T parallel_reduce(Index begin, Index end, T identity, Body body, Reduce reduce);
+
+    void wait_all();
+
+    // true when the calling thread is one of this pool's workers
+    bool on_worker_thread() const;
+
+    // run one queued task on the calling thread if it is a pool worker
+    // and anything is runnable. this is the help-first join primitive:
+    // a worker blocked on a subset of tasks (TaskGroup::wait) makes
+    // progress on the backlog -- usually its own children, which sit on
+    // its own deque -- instead of idling a thread per fork level.
+    bool try_run_one();
+    
+    size_t active_tasks() const;
+    
+    size_t pending_tasks() const;
+    
+    void shutdown_graceful();
+
+    void shutdown_immediate();
+
+    // stop this pool like shutdown_immediate but hand every task still
+    // queued -- lanes, deques, deadline heap, armed timers -- to a
+    // surviving pool instead of executing or dropping it. futures of
+    // the moved tasks stay valid and complete over there.
+    void drain_to(ThreadPool& other);
+    
+    size_t num_threads() const;
+
+    // workers currently attached (min_threads..max_threads); equal to
+    // num_threads() for a fixed-size pool
+    size_t active_threads() const;
+
+    struct Stats {
+        size_t tasks_completed;
+        size_t tasks_stolen;
+        size_t total_tasks_submitted;
+        // successful steal operations; tasks_stolen / steal_batches is
+        // the average batch size
+        size_t steal_batches;
+        // deadline-lane tasks dropped unexecuted because their deadline
+        // had already passed when a worker reached them
+        size_t tasks_shed;
+        // queued tasks evicted by OverflowPolicy::DROP_OLDEST
+        size_t tasks_dropped;
+        // admission high-water mark: the largest pending count an
+        // accepted submission ever observed. only maintained when
+        // max_pending is set; the unbounded pool does not pay the scan.
+        size_t peak_pending;
+    };
+    
+    Stats get_stats() const;
+
+    // instrumentation snapshot, scrapeable without stopping the pool.
+    // histogram bucket i counts events in [2^(i-1), 2^i) nanoseconds.
+    // all histogram and steal fields stay zero unless the pool was built
+    // with enable_instrumentation; queue depths are always live.
+    struct WorkerStats {
+        std::vector<uint64_t> wait_hist;  // submit -> start latency
+        std::vector<uint64_t> run_hist;   // task execution time
+        uint64_t steal_attempts;
+        uint64_t steal_successes;
+        size_t queue_depth;
+    };
+
+    struct DetailedStats {
+        std::vector<WorkerStats> workers;
+    };
+
+    DetailedStats get_detailed_stats() const;
+
+private:
+    void worker_thread(size_t thread_id);
+
+    // scaling controller: coarse periodic tick, grows the active set on
+    // sustained backlog and retires workers after a sustained idle spell
+    void controller_thread();
+
+    // hand a retiring worker's queued tasks to active siblings
+    void retire_worker(size_t thread_id);
+
+    // round-robin over the currently active workers
+    size_t pick_queue();
+
+    bool get_task(size_t thread_id, Task& task);
+
+    bool try_steal(size_t thread_id, Task& task);
+
+    bool has_queued_work() const;
+
+    void finish_task(size_t thread_id);
+
+    void handle_task_exception(std::exception_ptr error);
+
+    template<class U>
+    friend class TaskFuture;
+
+    // accounted push of an already-built Task (continuation handoff)
+    void enqueue_ready(Task task);
+
+    // accounted enqueue shared by the non-priority submit paths: a pool
+    // worker pushes onto its own deque bottom where the child is hot in
+    // its cache (the divide-and-conquer fast path), outsiders round-robin
+    // into an inbox
+    void enqueue_task(Task task);
+
+    // priority-aware variant: HIGH goes through the lanes, the rest
+    // through the local-queue routing above
+    void enqueue_task(Priority priority, Task task);
+
+    // instrumentation plumbing. recording uses steady_clock, which is a
+    // vdso read on linux -- close enough to a raw TSC read without the
+    // calibration headaches. the wrapper capture outgrows Task's inline
+    // buffer, so instrumented tasks pay one extra allocation; that is
+    // part of why this is opt-in.
+    static constexpr size_t HIST_BUCKETS = 32;
+
+    struct alignas(64) WorkerMetrics {
+        std::atomic<uint64_t> wait_hist[HIST_BUCKETS];
+        std::atomic<uint64_t> run_hist[HIST_BUCKETS];
+        std::atomic<uint64_t> steal_attempts;
+        std::atomic<uint64_t> steal_successes;
+
+        WorkerMetrics() : steal_attempts(0), steal_successes(0) {
+            for (size_t i = 0; i < HIST_BUCKETS; ++i) {
+                wait_hist[i].store(0, std::memory_order_relaxed);
+                run_hist[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    static size_t hist_bucket(uint64_t ns);
+
+    // wraps a task so the executing worker records its queue latency
+    // and run time; identity when instrumentation is off
+    Task maybe_instrument(Task task);
+
+    // timer plumbing: a deadline min-heap under its own small mutex.
+    // workers fire due entries before parking and bound their park by
+    // the nearest deadline, so dispatch jitter is one wakeup, not a
+    // polling period
+    struct TimerEntry {
+        std::chrono::steady_clock::time_point deadline;
+        Task task;
+    };
+
+    struct TimerLater {
+        bool operator()(const TimerEntry& a, const TimerEntry& b) const {
+            return a.deadline > b.deadline;
+        }
+    };
+
+    void add_timer(std::chrono::steady_clock::time_point deadline, Task task);
+
+    // fire due timers into the calling worker's local queue
+    void service_timers();
+
+    bool next_timer_deadline(std::chrono::steady_clock::time_point& next) const;
+
+    // keyed lane internals: enqueue hashes to the stable home worker,
+    // pop_keyed is the owner-side take, release_key is called by a
+    // thief's completion so the home worker may resume that key
+    void enqueue_keyed(uint64_t key, Task task);
+
+    bool pop_keyed(size_t thread_id, Task& task);
+
+    void clear_running(size_t thread_id);
+
+    void release_key(size_t target, uint64_t key);
+
+    // EDF lane: same heap shape as the timers but polled by get_task,
+    // and entries found past their deadline are shed instead of run
+    void add_deadline_task(std::chrono::steady_clock::time_point deadline, Task task);
+
+    bool pop_deadline_task(size_t thread_id, Task& task);
+
+    template<class FPtr>
+    void arm_periodic(std::chrono::steady_clock::time_point deadline,
+                      std::chrono::steady_clock::duration interval, FPtr fn);
+
+    // one-shot thread creation, deferred until first use in lazy mode
+    void ensure_spawned();
+    void spawn_workers();
+
+    // admission control gate; returns false when the overflow policy
+    // disposed of the task (ran it inline), true when the caller should
+    // enqueue it as usual
+    bool admit(Task& task);
+
+    // which pool worker is running on this thread, if any
+    struct WorkerIdentity {
+        ThreadPool* pool;
+        size_t id;
+    };
+    static thread_local WorkerIdentity current_worker_;
+
+    // wrap a packaged_task so its completion hands any registered
+    // continuation back into the pool
+    template<class R>
+    std::pair<Task, TaskFuture<R>> make_chain_task(std::packaged_task<R()> task);
+
+    // shared bookkeeping for one parallel_for/parallel_reduce call
+    template<class Index, class Leaf>
+    struct RangeState {
+        Leaf leaf;
+        size_t grain;
+        std::atomic<size_t> outstanding;
+        std::promise<void> done;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+        RangeState(Leaf l, size_t g)
+            : leaf(std::move(l))
+            , grain(g)
+            , outstanding(1) {}
+    };
+
+    // internal futureless enqueue used by the range machinery
+    template<class F>
+    void enqueue_internal(F&& f);
+
+    template<class Index, class Leaf>
+    void run_range(const std::shared_ptr<RangeState<Index, Leaf>>& state,
+                   Index begin, Index end);
+
+    std::vector<std::thread> workers_;
+
+    Options options_;
+    std::vector<int> pinned_cpu_;                     // worker id -> cpu, -1 unpinned
+    std::atomic<bool> spawned_{false};
+    std::mutex spawn_mutex_;
+    std::vector<size_t> worker_node_;                 // worker id -> node
+    std::vector<std::vector<size_t>> node_workers_;   // node -> worker ids
+    std::unique_ptr<std::atomic<size_t>[]> node_rr_;  // per-node round robin
+    
+    PriorityLanes lanes_;
+    EventCount parking_;
+
+    // elastic sizing state: workers with id >= active_target_ park on
+    // dormant_parking_ until the controller raises the target again
+    size_t min_threads_;
+    size_t max_threads_;
+    std::atomic<size_t> active_target_;
+    EventCount dormant_parking_;
+    std::thread controller_;
+    
+    // per-worker counter shard, padded to a cache line so two workers
+    // never false-share; submit writes the target worker's shard and a
+    // worker completes into its own, readers aggregate lazily
+    struct alignas(64) CounterShard {
+        std::atomic<size_t> submitted;
+        std::atomic<size_t> started;
+        std::atomic<size_t> completed;
+        std::atomic<size_t> stolen;
+        std::atomic<size_t> steal_batches;
+        std::atomic<size_t> shed;
+        std::atomic<size_t> dropped;
+        // tasks submitted but never run -- shed, dropped, or moved to
+        // another pool. kept apart from completed so started - completed
+        // cannot underflow and tasks_completed means what it says;
+        // pending aggregation subtracts both.
+        std::atomic<size_t> disposed;
+
+        CounterShard()
+            : submitted(0)
+            , started(0)
+            , completed(0)
+            , stolen(0)
+            , steal_batches(0)
+            , shed(0)
+            , dropped(0)
+            , disposed(0) {}
+    };
+
+    // per-worker keyed FIFO. external pushes and the owner's pops keep
+    // strict arrival order per key; running/stolen bookkeeping under the
+    // same mutex is what lets thieves take keyed work without breaking
+    // that order. the atomic size mirror keeps the empty-lane fast path
+    // to one relaxed load.
+    struct KeyedLane {
+        std::mutex mutex;
+        std::deque<std::pair<uint64_t, Task>> tasks;
+        std::atomic<size_t> size{0};
+        // key of the keyed task the home worker is executing right now,
+        // cleared by a completion wrapper the moment the task finishes
+        uint64_t running_key = 0;
+        bool running = false;
+        // keys currently executing on thieves; entries with these keys
+        // stay queued until the thief's completion releases them
+        std::vector<uint64_t> stolen_keys;
+    };
+
+    // everything one worker touches on every scheduling decision lives
+    // in one padded block, and the blocks form a contiguous array. the
+    // deques, the steal rng and the counters used to be separate heap
+    // objects small enough to share lines between workers. the rng is
+    // also owner-only now; the old pool-wide generator was hammered
+    // from every steal scan without a lock, a data race on top of a
+    // sharing hot spot. it gets its own line so thief traffic on the
+    // deques' shared words never invalidates it.
+    struct alignas(64) WorkerBlock {
+        WorkStealingQueue queue;      // MEDIUM lane
+        WorkStealingQueue low_queue;  // LOW lane, drained second
+        KeyedLane keyed;
+        alignas(64) std::mt19937 rng;
+        // owner-only: MEDIUM tasks taken since the last LOW one, drives
+        // the Options::low_ratio anti-starvation gate
+        size_t since_low = 0;
+        CounterShard counters;
+    };
+
+    std::unique_ptr<WorkerBlock[]> worker_blocks_;
+    // null unless Options::enable_instrumentation
+    std::unique_ptr<WorkerMetrics[]> metrics_;
+
+    // read by every worker on every loop pass, written once at
+    // shutdown: isolated so stats or cursor writes nearby never
+    // invalidate the line they sit on
+    alignas(64) std::atomic<bool> stop_;
+    std::atomic<bool> immediate_stop_;
+    // guards the one-shot queue drain in shutdown_immediate, which can
+    // be reached twice after a fail-fast trip
+    std::atomic<bool> drained_{false};
+
+    // write-hot round-robin cursor bumped by every external submit,
+    // kept off the read-mostly lines above
+    alignas(64) std::atomic<size_t> next_queue_;
+
+    std::vector<TimerEntry> timers_;
+    mutable std::mutex timer_mutex_;
+    // fast-path guard so idle loops skip the timer mutex entirely
+    std::atomic<size_t> timer_count_{0};
+
+    std::vector<TimerEntry> deadline_heap_;
+    std::mutex deadline_mutex_;
+    // same trick as timer_count_: get_task skips the mutex while empty
+    std::atomic<size_t> deadline_count_{0};
+
+    std::condition_variable wait_cv_;
+    std::mutex wait_mutex_;
+    // wait_all registrations; completions skip the cv entirely while
+    // this is zero
+    std::atomic<int> wait_waiters_{0};
+    // submitters parked by OverflowPolicy::BLOCK; same gate pattern
+    std::atomic<int> admission_waiters_{0};
+    std::atomic<size_t> peak_pending_{0};
+
+    std::function<void(std::exception_ptr)> exception_handler_;
+    mutable std::mutex handler_mutex_;
+};
+
+// scoped set of related tasks: run() submits into the pool, wait()
+// blocks until just this group drains. two independent pipeline stages
+// can each wait on their own group instead of interfering through
+// wait_all. the first exception thrown by a group task is captured and
+// rethrown from wait(). joins are help-first: a worker calling wait()
+// executes queued work instead of blocking, so groups nest safely for
+// recursive fork/join (each level is one atomic counter, no futures).
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool)
+        : pool_(pool)
+        , outstanding_(0) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    ~TaskGroup() {
+        try {
+            wait();
+        } catch (...) {
+            // wait() was never called, nobody left to rethrow to
+        }
+    }
+
+    template<class F>
+    void run(F&& f) {
+        outstanding_.fetch_add(1, std::memory_order_seq_cst);
+        pool_.post([this, f = std::forward<F>(f)]() mutable {
+            try {
+                f();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+            finish();
+        });
+    }
+
+    void wait() {
+        while (outstanding_.load(std::memory_order_seq_cst) > 0) {
+            // help-first join: a pool worker waiting on its own fork
+            // tree executes queued tasks -- its children sit on its own
+            // deque and come back LIFO -- so recursive fork/join never
+            // idles a worker per level and works even on one thread
+            if (pool_.on_worker_thread()) {
+                if (pool_.try_run_one()) {
+                    continue;
+                }
+                // nothing runnable right now but the group is still
+                // live (children running elsewhere may fork more);
+                // finish() only notifies at zero, so the sleep is
+                // bounded to keep picking up late helpable work
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                    return outstanding_.load(std::memory_order_seq_cst) == 0;
+                });
+            } else {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] {
+                    return outstanding_.load(std::memory_order_seq_cst) == 0;
+                });
+            }
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::swap(error, error_);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void finish() {
+        // only the group's last task pays for the lock and notify
+        if (outstanding_.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+
+    ThreadPool& pool_;
+    std::atomic<size_t> outstanding_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::exception_ptr error_;
+};
+
+// ordered multi-stage execution over the pool. declare stages up
+// front (each with a parallelism limit; serial stages additionally
+// process items in exact feed order), then push items in. a stage
+// transition is just the completing worker posting the next stage,
+// which lands on its own deque -- no futures, no per-item cv, and the
+// item stays hot in that worker's cache. push() blocks once
+// max_in_flight items are inside the pipeline, which is the only
+// backpressure mechanism stages need.
+template<class Item>
+class Pipeline {
+public:
+    Pipeline(ThreadPool& pool, size_t max_in_flight)
+        : pool_(pool)
+        , max_in_flight_(max_in_flight)
+        , in_flight_(0)
+        , next_seq_(0) {
+        if (max_in_flight == 0) {
+            throw std::invalid_argument("Pipeline needs room for at least one item");
+        }
+    }
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    ~Pipeline() {
+        wait();
+    }
+
+    // stages must all be declared before the first push
+    void add_stage(size_t parallelism, std::function<void(Item&)> fn) {
+        if (parallelism == 0) {
+            throw std::invalid_argument("Pipeline stage needs parallelism >= 1");
+        }
+        stages_.push_back(std::make_unique<Stage>(std::move(fn), parallelism, false));
+    }
+
+    // parallelism 1 and items pass through in exact feed order
+    void add_serial_stage(std::function<void(Item&)> fn) {
+        stages_.push_back(std::make_unique<Stage>(std::move(fn), 1, true));
+    }
+
+    // blocks while the pipeline is full; that stall is the backpressure
+    void push(Item item) {
+        if (stages_.empty()) {
+            throw std::logic_error("Pipeline has no stages");
+        }
+
+        auto work = std::make_unique<InFlight>();
+        work->item = std::move(item);
+        {
+            std::unique_lock<std::mutex> lock(flow_mutex_);
+            flow_cv_.wait(lock, [this] { return in_flight_ < max_in_flight_; });
+            in_flight_++;
+            work->seq = next_seq_++;
+        }
+
+        enter_stage(0, std::move(work));
+    }
+
+    // until every pushed item has left the last stage
+    void wait() {
+        std::unique_lock<std::mutex> lock(flow_mutex_);
+        flow_cv_.wait(lock, [this] { return in_flight_ == 0; });
+    }
+
+private:
+    struct InFlight {
+        uint64_t seq;
+        Item item;
+        // a failed item keeps flowing (serial stages must see every
+        // seq) but skips the remaining stage bodies
+        bool failed = false;
+    };
+
+    using WorkPtr = std::unique_ptr<InFlight>;
+
+    struct Stage {
+        std::function<void(Item&)> fn;
+        size_t parallelism;
+        bool serial;
+
+        std::mutex mutex;
+        size_t running = 0;
+        uint64_t next_seq = 0;                 // serial stages only
+        std::deque<WorkPtr> waiting;           // parallel stages
+        std::map<uint64_t, WorkPtr> reorder;   // serial stages
+
+        Stage(std::function<void(Item&)> f, size_t p, bool s)
+            : fn(std::move(f))
+            , parallelism(p)
+            , serial(s) {}
+    };
+
+    void enter_stage(size_t index, WorkPtr work) {
+        Stage& stage = *stages_[index];
+        WorkPtr runnable;
+        {
+            std::lock_guard<std::mutex> lock(stage.mutex);
+            if (stage.serial) {
+                // out-of-order arrivals park in the reorder buffer until
+                // their turn comes up
+                stage.reorder.emplace(work->seq, std::move(work));
+                runnable = take_serial(stage);
+            } else if (stage.running < stage.parallelism) {
+                stage.running++;
+                runnable = std::move(work);
+            } else {
+                stage.waiting.push_back(std::move(work));
+            }
+        }
+        if (runnable) {
+            launch(index, std::move(runnable));
+        }
+    }
+
+    // caller holds stage.mutex
+    WorkPtr take_serial(Stage& stage) {
+        if (stage.running > 0) {
+            return nullptr;
+        }
+        auto it = stage.reorder.find(stage.next_seq);
+        if (it == stage.reorder.end()) {
+            return nullptr;
+        }
+        WorkPtr work = std::move(it->second);
+        stage.reorder.erase(it);
+        stage.running = 1;
+        return work;
+    }
+
+    void launch(size_t index, WorkPtr work) {
+        // posting from the completing worker lands on its own deque, so
+        // the item's data follows the worker's cache
+        pool_.post([this, index, w = std::move(work)]() mutable {
+            run_stage(index, std::move(w));
+        });
+    }
+
+    void run_stage(size_t index, WorkPtr work) {
+        Stage& stage = *stages_[index];
+        std::exception_ptr error;
+        if (!work->failed) {
+            try {
+                stage.fn(work->item);
+            } catch (...) {
+                work->failed = true;
+                error = std::current_exception();
+            }
+        }
+
+        exit_stage(index);
+
+        if (index + 1 < stages_.size()) {
+            enter_stage(index + 1, std::move(work));
+        } else {
+            retire_item();
+        }
+
+        if (error) {
+            // post() routes it to the pool's exception handler
+            std::rethrow_exception(error);
+        }
+    }
+
+    void exit_stage(size_t index) {
+        Stage& stage = *stages_[index];
+        WorkPtr runnable;
+        {
+            std::lock_guard<std::mutex> lock(stage.mutex);
+            stage.running--;
+            if (stage.serial) {
+                stage.next_seq++;
+                runnable = take_serial(stage);
+            } else if (!stage.waiting.empty() && stage.running < stage.parallelism) {
+                runnable = std::move(stage.waiting.front());
+                stage.waiting.pop_front();
+                stage.running++;
+            }
+        }
+        if (runnable) {
+            launch(index, std::move(runnable));
+        }
+    }
+
+    void retire_item() {
+        std::lock_guard<std::mutex> lock(flow_mutex_);
+        in_flight_--;
+        flow_cv_.notify_all();
+    }
+
+    ThreadPool& pool_;
+    std::vector<std::unique_ptr<Stage>> stages_;
+
+    size_t max_in_flight_;
+    size_t in_flight_;
+    uint64_t next_seq_;
+    std::mutex flow_mutex_;
+    std::condition_variable flow_cv_;
+};
+
+template<class F, class... Args>
+auto ThreadPool::submit(F&& f, Args&&... args)
+    -> std::future<typename std::invoke_result<F, Args...>::type> {
+    return submit(Priority::MEDIUM, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<class F, class... Args>
+auto ThreadPool::submit(Priority priority, F&& f, Args&&... args) 
+    -> std::future<typename std::invoke_result<F, Args...>::type> {
+    
+    using return_type = typename std::invoke_result<F, Args...>::type;
+    
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+    
+    std::packaged_task<return_type()> task(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    std::future<return_type> result = task.get_future();
+
+    // packaged_task already routes exceptions into the future and Task is
+    // move-only, so it goes into the queue as-is; completion bookkeeping
+    // happens in the worker loop against the executing worker's shard
+    Task wrapped_task(std::move(task));
+
+    enqueue_task(priority, std::move(wrapped_task));
+
+    return result;
+}
+
+template<class Iterator>
+auto ThreadPool::submit_bulk(Iterator first, Iterator last)
+    -> std::vector<std::future<typename std::invoke_result<
+           typename std::iterator_traits<Iterator>::value_type>::type>> {
+    return submit_bulk(Priority::MEDIUM, first, last);
+}
+
+template<class Iterator>
+auto ThreadPool::submit_bulk(Priority priority, Iterator first, Iterator last)
+    -> std::vector<std::future<typename std::invoke_result<
+           typename std::iterator_traits<Iterator>::value_type>::type>> {
+
+    using callable_type = typename std::iterator_traits<Iterator>::value_type;
+    using return_type = typename std::invoke_result<callable_type>::type;
+
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    std::vector<std::future<return_type>> results;
+    results.reserve(count);
+
+    if (count == 0) {
+        return results;
+    }
+
+    ensure_spawned();
+
+    // each task is admitted individually -- a bulk batch is exactly the
+    // burst max_pending exists to bound. admission skips (CALLER_RUNS
+    // running one inline) shrink the batch, so counters are bumped per
+    // batch with the admitted size; the unbounded pool admits everything
+    // and keeps the one-bump-per-batch behaviour.
+    if (priority == Priority::HIGH) {
+        std::vector<Task> batch;
+        batch.reserve(count);
+        for (Iterator it = first; it != last; ++it) {
+            std::packaged_task<return_type()> task(*it);
+            results.push_back(task.get_future());
+            Task entry(std::move(task));
+            if (!admit(entry)) {
+                continue;
+            }
+            batch.emplace_back(maybe_instrument(std::move(entry)));
+        }
+        worker_blocks_[next_queue_++ % max_threads_].counters.submitted.fetch_add(
+            batch.size(), std::memory_order_seq_cst);
+        for (Task& task : batch) {
+            lanes_.push(priority, std::move(task));
+        }
+    } else {
+        size_t num_queues = active_target_.load(std::memory_order_relaxed);
+        size_t chunk = (count + num_queues - 1) / num_queues;
+
+        static std::atomic<size_t> bulk_counter{0};
+        size_t queue_id = bulk_counter++ % num_queues;
+
+        Iterator it = first;
+        while (it != last) {
+            std::vector<Task> batch;
+            batch.reserve(chunk);
+            for (size_t i = 0; i < chunk && it != last; ++i, ++it) {
+                std::packaged_task<return_type()> task(*it);
+                results.push_back(task.get_future());
+                Task entry(std::move(task));
+                if (!admit(entry)) {
+                    continue;
+                }
+                batch.emplace_back(maybe_instrument(std::move(entry)));
+            }
+            if (batch.empty()) {
+                continue;
+            }
+            worker_blocks_[queue_id].counters.submitted.fetch_add(
+                batch.size(), std::memory_order_seq_cst);
+            WorkerBlock& block = worker_blocks_[queue_id];
+            (priority == Priority::LOW ? block.low_queue : block.queue)
+                .push_bulk(std::move(batch));
+            queue_id = (queue_id + 1) % num_queues;
+        }
+    }
+
+    // wake only as many workers as the batch can occupy
+    if (count >= active_target_.load(std::memory_order_relaxed)) {
+        parking_.notify_all();
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            parking_.notify_one();
+        }
+    }
+
+    return results;
+}
+
+template<class F, class... Args>
+auto ThreadPool::submit_to_node(size_t node, F&& f, Args&&... args)
+    -> std::future<typename std::invoke_result<F, Args...>::type> {
+
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    if (node >= node_workers_.size() || node_workers_[node].empty()) {
+        throw std::invalid_argument("submit_to_node: no workers on that node");
+    }
+
+    ensure_spawned();
+
+    std::packaged_task<return_type()> task(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    std::future<return_type> result = task.get_future();
+
+    const std::vector<size_t>& ids = node_workers_[node];
+    size_t thread_id = ids[node_rr_[node]++ % ids.size()];
+    worker_blocks_[thread_id].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+    worker_blocks_[thread_id].queue.push(maybe_instrument(Task(std::move(task))));
+    parking_.notify_one();
+
+    return result;
+}
+
+template<class R>
+std::pair<Task, TaskFuture<R>> ThreadPool::make_chain_task(std::packaged_task<R()> task) {
+    auto state = std::make_shared<TaskChainState>();
+    state->pool = this;
+
+    std::future<R> future = task.get_future();
+
+    Task wrapped([state, task = std::move(task)]() mutable {
+        task();
+        Task continuation;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->completed = true;
+            continuation = std::move(state->continuation);
+        }
+        if (continuation) {
+            state->pool->enqueue_ready(std::move(continuation));
+        }
+    });
+
+    return {std::move(wrapped), TaskFuture<R>(std::move(future), std::move(state), this)};
+}
+
+template<class F, class... Args>
+auto ThreadPool::async(F&& f, Args&&... args)
+    -> TaskFuture<typename std::invoke_result<F, Args...>::type> {
+
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    std::packaged_task<return_type()> task(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    auto chain = make_chain_task(std::move(task));
+
+    enqueue_task(std::move(chain.first));
+
+    return std::move(chain.second);
+}
+
+template<class T>
+template<class G>
+auto TaskFuture<T>::then(G&& g) -> TaskFuture<then_result_t<G>> {
+    using result_type = then_result_t<G>;
+
+    // the continuation reads a future that is guaranteed ready by the
+    // time anyone runs it, so get() here never blocks a worker
+    std::packaged_task<result_type()> task(
+        [future = std::move(future_), g = std::forward<G>(g)]() mutable {
+            if constexpr (std::is_void<T>::value) {
+                future.get();
+                return g();
+            } else {
+                return g(future.get());
+            }
+        });
+
+    auto chain = pool_->make_chain_task(std::move(task));
+
+    bool ready;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        ready = state_->completed;
+        if (!ready) {
+            state_->continuation = std::move(chain.first);
+        }
+    }
+    if (ready) {
+        pool_->enqueue_ready(std::move(chain.first));
+    }
+
+    return std::move(chain.second);
+}
+
+template<class F>
+void ThreadPool::post(F&& f) {
+    post(Priority::MEDIUM, std::forward<F>(f));
+}
+
+template<class F>
+void ThreadPool::post(Priority priority, F&& f) {
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    Task task([this, f = std::forward<F>(f)]() mutable {
+        try {
+            f();
+        } catch (...) {
+            handle_task_exception(std::current_exception());
+        }
+    });
+
+    enqueue_task(priority, std::move(task));
+}
+
+template<class Rep, class Period, class F>
+void ThreadPool::submit_after(std::chrono::duration<Rep, Period> delay, F&& f) {
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay);
+
+    Task task([this, f = std::forward<F>(f)]() mutable {
+        try {
+            f();
+        } catch (...) {
+            handle_task_exception(std::current_exception());
+        }
+    });
+
+    add_timer(deadline, std::move(task));
+}
+
+template<class Clock, class Duration, class F>
+void ThreadPool::submit_at(std::chrono::time_point<Clock, Duration> when, F&& f) {
+    submit_after(when - Clock::now(), std::forward<F>(f));
+}
+
+template<class F, class... Args>
+auto ThreadPool::submit_with_deadline(std::chrono::steady_clock::time_point deadline,
+                                      F&& f, Args&&... args)
+    -> std::future<typename std::invoke_result<F, Args...>::type> {
+
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    std::packaged_task<return_type()> task(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    std::future<return_type> result = task.get_future();
+
+    // deadline work counts against max_pending like any other backlog;
+    // an inline CALLER_RUNS execution trivially beats the deadline
+    Task entry(std::move(task));
+    if (!admit(entry)) {
+        return result;
+    }
+
+    worker_blocks_[pick_queue()].counters.submitted.fetch_add(1, std::memory_order_seq_cst);
+    add_deadline_task(deadline, maybe_instrument(std::move(entry)));
+
+    return result;
+}
+
+template<class F, class... Args>
+auto ThreadPool::submit_with_key(uint64_t key, F&& f, Args&&... args)
+    -> std::future<typename std::invoke_result<F, Args...>::type> {
+
+    using return_type = typename std::invoke_result<F, Args...>::type;
+
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    std::packaged_task<return_type()> task(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+    );
+
+    std::future<return_type> result = task.get_future();
+
+    enqueue_keyed(key, Task(std::move(task)));
+
+    return result;
+}
+
+template<class Rep, class Period, class F>
+void ThreadPool::submit_periodic(std::chrono::duration<Rep, Period> interval, F&& f) {
+    if (stop_ || immediate_stop_) {
+        throw std::runtime_error("Cannot submit task to stopped thread pools");
+    }
+
+    // the callable outlives any single firing, so it lives in a shared
+    // ptr and each firing re-arms the next one off the same instance
+    auto fn = std::make_shared<typename std::decay<F>::type>(std::forward<F>(f));
+    auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+    arm_periodic(std::chrono::steady_clock::now() + step, step, std::move(fn));
+}
+
+template<class FPtr>
+void ThreadPool::arm_periodic(std::chrono::steady_clock::time_point deadline,
+                              std::chrono::steady_clock::duration interval, FPtr fn) {
+    add_timer(deadline, Task([this, deadline, interval, fn]() {
+        try {
+            (*fn)();
+        } catch (...) {
+            handle_task_exception(std::current_exception());
+        }
+        if (!stop_ && !immediate_stop_) {
+            arm_periodic(deadline + interval, interval, fn);
+        }
+    }));
+}
+
+template<class F>
+void ThreadPool::enqueue_internal(F&& f) {
+    enqueue_task(Task(std::forward<F>(f)));
+}
+
+template<class Index, class Leaf>
+void ThreadPool::run_range(const std::shared_ptr<RangeState<Index, Leaf>>& state,
+                           Index begin, Index end) {
+    // peel off right halves until the range is down to one grain; the
+    // halves sit in the queue where idle workers steal and split them
+    // further, so task count stays proportional to worker count
+    while (static_cast<size_t>(end - begin) > state->grain) {
+        Index mid = begin + (end - begin) / 2;
+        state->outstanding.fetch_add(1, std::memory_order_relaxed);
+        enqueue_internal([this, state, mid, end]() {
+            run_range(state, mid, end);
+        });
+        end = mid;
+    }
+
+    try {
+        state->leaf(begin, end);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state->error_mutex);
+        if (!state->error) {
+            state->error = std::current_exception();
+        }
+    }
+
+    if (state->outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        state->done.set_value();
+    }
+}
+
+template<class Index, class Body>
+void ThreadPool::parallel_for(Index begin, Index end, Body body) {
+    if (begin >= end) {
+        return;
+    }
+
+    auto leaf = [body = std::move(body)](Index b, Index e) {
+        for (Index i = b; i < e; ++i) {
+            body(i);
+        }
+    };
+
+    size_t total = static_cast<size_t>(end - begin);
+    // max_threads_, not workers_.size(): the vector is still being
+    // filled (or empty, on a lazy pool) when an early caller gets here
+    size_t grain = total / (8 * max_threads_);
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    auto state = std::make_shared<RangeState<Index, decltype(leaf)>>(std::move(leaf), grain);
+    std::future<void> done = state->done.get_future();
+
+    enqueue_internal([this, state, begin, end]() {
+        run_range(state, begin, end);
+    });
+
+    done.wait();
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
+
+template<class Index, class T, class Body, class Reduce>
+T ThreadPool::parallel_reduce(Index begin, Index end, T identity, Body body, Reduce reduce) {
+    if (begin >= end) {
+        return identity;
+    }
+
+    // caller blocks below until every leaf finished, so stack references
+    // in the leaf stay valid
+    T result = identity;
+    std::mutex result_mutex;
+
+    auto leaf = [&result, &result_mutex, body = std::move(body),
+                 reduce = std::move(reduce), identity](Index b, Index e) {
+        T partial = body(b, e, identity);
+        std::lock_guard<std::mutex> lock(result_mutex);
+        result = reduce(std::move(result), std::move(partial));
+    };
+
+    size_t total = static_cast<size_t>(end - begin);
+    // max_threads_, not workers_.size(): the vector is still being
+    // filled (or empty, on a lazy pool) when an early caller gets here
+    size_t grain = total / (8 * max_threads_);
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    auto state = std::make_shared<RangeState<Index, decltype(leaf)>>(std::move(leaf), grain);
+    std::future<void> done = state->done.get_future();
+
+    enqueue_internal([this, state, begin, end]() {
+        run_range(state, begin, end);
+    });
+
+    done.wait();
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
     return result;
 }
 